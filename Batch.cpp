@@ -0,0 +1,212 @@
+//
+//  Batch.cpp
+//  Heartbeat
+//
+//  Created by Philipp Rouast on 19/10/2026.
+//  Copyright © 2026 Philipp Roüast. All rights reserved.
+//
+
+#include "Batch.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <sys/stat.h>
+
+#include <opencv2/imgproc.hpp>
+#include <opencv2/videoio.hpp>
+
+#define TIME_BASE 0.001
+
+using namespace cv;
+using namespace std;
+
+static const char *VIDEO_EXTENSIONS[] = {".avi", ".m4v", ".mkv", ".mov", ".mp4", ".mpeg", ".mpg", ".webm", ".wmv"};
+static const char *STATUS_NAMES[] = {"processed", "skipped", "failed"};
+
+static bool isVideo(const string &path) {
+    const size_t dot = path.find_last_of(".");
+    if (dot == string::npos) return false;
+    string extension = path.substr(dot);
+    transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    for (size_t i = 0; i < sizeof(VIDEO_EXTENSIONS) / sizeof(VIDEO_EXTENSIONS[0]); i++) {
+        if (extension == VIDEO_EXTENSIONS[i]) return true;
+    }
+    return false;
+}
+
+static int64_t fileSize(const string &path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 ? (int64_t)st.st_size : 0;
+}
+
+bool BatchRunner::load(const string &source) {
+
+    struct stat st;
+    if (stat(source.c_str(), &st) != 0) {
+        return false;
+    }
+
+    files.clear();
+
+    if (S_ISDIR(st.st_mode)) {
+
+        // All recordings in the directory
+        vector<String> found;
+        glob(source, found, false);
+        for (size_t i = 0; i < found.size(); i++) {
+            if (isVideo(found[i])) files.push_back(found[i]);
+        }
+
+    } else {
+
+        // One path per line, relative to the manifest
+        const size_t slash = source.find_last_of("/");
+        const string base = slash == string::npos ? "" : source.substr(0, slash + 1);
+        ifstream manifest(source.c_str());
+        string line;
+        while (getline(manifest, line)) {
+            line.erase(line.find_last_not_of(" \t\r\n") + 1);
+            line.erase(0, line.find_first_not_of(" \t"));
+            if (line.empty() || line[0] == '#') continue;
+            files.push_back(line[0] == '/' ? line : base + line);
+        }
+    }
+
+    // Largest first, so the last files to start are the short ones
+    vector<pair<int64_t, string> > sized;
+    for (size_t i = 0; i < files.size(); i++) {
+        sized.push_back(make_pair(-fileSize(files[i]), files[i]));
+    }
+    sort(sized.begin(), sized.end());
+    for (size_t i = 0; i < sized.size(); i++) {
+        files[i] = sized[i].second;
+    }
+
+    return true;
+}
+
+BatchResult BatchRunner::process(RPPG &rppg, const RPPGSettings &settings, const string &path, bool force) const {
+
+    BatchResult result;
+    result.path = path;
+    result.status = failed;
+    result.frames = 0;
+    result.duration = 0;
+    result.seconds = 0;
+
+    // Outputs go next to the recording, like a single run would write them
+    RPPGSettings recording = settings;
+    recording.logPath = path.substr(0, path.find_last_of("."));
+    recording.timeBase = TIME_BASE;
+    recording.gui = false;
+    recording.tracePath = "";
+    const string summaryPath = RPPG::logfilePath(recording) + "_summary.csv";
+
+    // The summary is written last, so it marks complete outputs
+    if (!force) {
+        ifstream summary(summaryPath.c_str());
+        string header, row;
+        if (getline(summary, header) && getline(summary, row) &&
+            sscanf(row.c_str(), "%d;%lf;%lf", &result.frames, &result.duration, &result.seconds) == 3) {
+            result.status = skipped;
+            return result;
+        }
+    }
+
+    VideoCapture cap(path);
+    if (!cap.isOpened()) {
+        return result;
+    }
+
+    const int64 start = getTickCount();
+
+    recording.width = cap.get(CAP_PROP_FRAME_WIDTH);
+    recording.height = cap.get(CAP_PROP_FRAME_HEIGHT);
+    const double fps = cap.get(CAP_PROP_FPS);
+
+    rppg.load(recording);
+
+    Mat frameRGB, frameGray;
+    int64_t time = 0;
+    int i = 0;
+
+    while (cap.read(frameRGB) && !frameRGB.empty()) {
+
+        cvtColor(frameRGB, frameGray, COLOR_BGR2GRAY);
+        equalizeHist(frameGray, frameGray);
+
+        time = (int64_t)cap.get(CAP_PROP_POS_MSEC);
+
+        if (i % settings.downsample == 0) {
+            rppg.processFrame(frameRGB, frameGray, time);
+        }
+
+        i++;
+    }
+
+    rppg.exit();
+
+    result.status = processed;
+    result.frames = i;
+    result.duration = fps > 0 ? i / fps : time * TIME_BASE;
+    result.seconds = (getTickCount() - start) / getTickFrequency();
+
+    ofstream summary(summaryPath.c_str());
+    summary << "frames;duration;seconds\n";
+    summary << result.frames << ";" << result.duration << ";" << result.seconds << "\n";
+
+    return result;
+}
+
+void BatchRunner::run(const RPPGSettings &settings, int threads, bool force,
+                      vector<BatchResult> &results) {
+
+    results.resize(files.size());
+
+    // Workers pull the next file until none are left
+    atomic<size_t> next(0);
+    atomic<size_t> done(0);
+
+    // Keep the pipelines quiet, progress goes to stderr
+    QuietConsole quiet;
+
+    vector<thread> workers;
+    const int count = std::max(1, std::min(threads, (int)files.size()));
+    for (int w = 0; w < count; w++) {
+        workers.push_back(thread([&]() {
+            RPPG rppg = RPPG();
+            for (size_t i = next++; i < files.size(); i = next++) {
+                results[i] = process(rppg, settings, files[i], force);
+                cerr << "[" << ++done << "/" << files.size() << "] " << files[i] << " " << STATUS_NAMES[results[i].status] << endl;
+            }
+        }));
+    }
+    for (size_t w = 0; w < workers.size(); w++) {
+        workers[w].join();
+    }
+}
+
+bool BatchRunner::write(const string &path, const vector<BatchResult> &results) {
+
+    ofstream table(path.c_str());
+    if (!table.is_open()) {
+        return false;
+    }
+
+    // Real-time factor is processing time over video time, below 1 is faster than real time
+    table << "file;status;frames;duration;seconds;realtime_factor\n";
+
+    for (size_t i = 0; i < results.size(); i++) {
+        const BatchResult &r = results[i];
+        table << r.path << ";" << STATUS_NAMES[r.status] << ";" << r.frames << ";"
+              << r.duration << ";" << r.seconds << ";";
+        if (r.duration > 0) table << r.seconds / r.duration;
+        table << "\n";
+    }
+
+    return table.good();
+}
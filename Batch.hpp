@@ -0,0 +1,65 @@
+//
+//  Batch.hpp
+//  Heartbeat
+//
+//  Created by Philipp Rouast on 19/10/2026.
+//  Copyright © 2026 Philipp Roüast. All rights reserved.
+//
+
+#ifndef Batch_hpp
+#define Batch_hpp
+
+#include <string>
+#include <vector>
+
+#include "RPPG.hpp"
+
+#include <stdio.h>
+
+/* BATCH PROCESSING
+ *
+ * Runs the pipeline over a directory or manifest of recordings. Each worker
+ * owns one RPPG, so the face detector is loaded once per worker rather than
+ * once per file. Workers take the next file from a shared queue ordered by
+ * size, largest first, which keeps the tail short. Outputs are written next
+ * to each recording; a summary file marks them complete so reruns skip
+ * them. */
+
+enum batchStatus { processed, skipped, failed };
+
+struct BatchResult {
+    std::string path;
+    batchStatus status;
+    int frames;
+    double duration;  // seconds of video
+    double seconds;   // processing time
+};
+
+class BatchRunner {
+
+public:
+
+    BatchRunner() {;}
+
+    // Collect the recordings of a directory, or the paths listed in a manifest
+    bool load(const std::string &source);
+
+    // Process all recordings with the settings on up to threads workers; the
+    // input and log path follow each recording. force reprocesses recordings
+    // with complete outputs
+    void run(const RPPGSettings &settings, int threads, bool force,
+             std::vector<BatchResult> &results);
+
+    // Summary with one row per recording
+    static bool write(const std::string &path, const std::vector<BatchResult> &results);
+
+    size_t size() const { return files.size(); }
+
+private:
+
+    BatchResult process(RPPG &rppg, const RPPGSettings &settings, const std::string &path, bool force) const;
+
+    std::vector<std::string> files;
+};
+
+#endif /* Batch_hpp */
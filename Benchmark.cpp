@@ -0,0 +1,487 @@
+//
+//  Benchmark.cpp
+//  Heartbeat
+//
+//  Created by Philipp Rouast on 19/10/2026.
+//  Copyright © 2026 Philipp Roüast. All rights reserved.
+//
+
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <opencv2/imgproc.hpp>
+
+#include "RPPG.hpp"
+#include "Synthetic.hpp"
+#include "StreamBatch.hpp"
+#include "dsp.hpp"
+
+#define HAAR_CLASSIFIER_PATH "haarcascade_frontalface_alt.xml"
+#define DNN_PROTO_PATH "opencv/deploy.prototxt"
+#define DNN_MODEL_PATH "opencv/res10_300x300_ssd_iter_140000.caffemodel"
+
+#define DEFAULT_RPPG_ALGORITHMS "g,pca,xminay,pos,chrom"
+#define DEFAULT_FACEDET_ALGORITHMS "haar,deep"
+#define DEFAULT_WINDOWS "5,10" // seconds
+#define DEFAULT_INTERPOLATE "true"
+#define DEFAULT_WIDTH 640
+#define DEFAULT_HEIGHT 480
+#define DEFAULT_FPS 30
+#define DEFAULT_DURATION 30 // seconds
+#define DEFAULT_BPM 72
+#define DEFAULT_WAVEFORM "sine"
+#define DEFAULT_AMPLITUDE 2 // intensity levels
+#define DEFAULT_MOTION 0 // pixels
+#define DEFAULT_NOISE 1 // intensity levels
+#define DEFAULT_DRIFT 0
+#define DEFAULT_LOG_PATH "" // no log files
+#define DEFAULT_SUBJECTS 64 // subjects for the DSP capacity comparison, 0 skips it
+#define FIRST_ESTIMATE_ERROR 3 // bpm within the ground truth that counts as a valid estimate
+#define DSP_ROUNDS 20 // estimations per subject in the comparison
+#define SUBJECT_BPM_SPREAD 20 // subjects' heart rates spread around the ground truth
+#define KERNEL_CALLS 2000 // calls per kernel timing
+#define KERNEL_LANES 64 // subjects per lane kernel call
+#define TIME_BASE 0.001
+#define LOW_BPM 42
+#define HIGH_BPM 240
+
+using namespace cv;
+using namespace std;
+
+static const char *RPPG_NAMES[] = {"g", "pca", "xminay", "pos", "chrom"};
+static const char *FACEDET_NAMES[] = {"haar", "deep"};
+
+static string getArg(int argc, char * argv[], const string &name, const string &fallback) {
+    for (int i = 1; i < argc - 1; i++) {
+        if (name == argv[i]) {
+            return argv[i + 1];
+        }
+    }
+    return fallback;
+}
+
+static vector<string> split(const string &s) {
+    vector<string> items;
+    stringstream ss(s);
+    string item;
+    while (getline(ss, item, ',')) {
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
+static int indexOf(const char *names[], int n, const string &s, const string &what) {
+    for (int i = 0; i < n; i++) {
+        if (s == names[i]) return i;
+    }
+    cerr << "Please specify valid " << what << " (" << s << ")!" << endl;
+    exit(0);
+}
+
+static bool exists(const string &path) {
+    ifstream test(path);
+    return (bool)test;
+}
+
+// JSON number, null if not finite
+static string number(double v) {
+    if (!std::isfinite(v)) return "null";
+    ostringstream ss;
+    ss.precision(6);
+    ss << v;
+    return ss.str();
+}
+
+static double ms(int64 ticks, int frames) {
+    return frames > 0 ? ticks * 1000.0 / getTickFrequency() / frames : NAN;
+}
+
+// Runs one configuration over the whole video and appends its JSON object
+static void run(SyntheticVideo &video, rPPGAlgorithm rPPGAlg, faceDetAlgorithm faceDetAlg,
+                int window, bool interpolate, const string &logPath, ostream &json) {
+
+    RPPGSettings settings;
+    settings.rPPGAlg = rPPGAlg;
+    settings.faceDetAlg = faceDetAlg;
+    settings.width = video.getWidth();
+    settings.height = video.getHeight();
+    settings.timeBase = TIME_BASE;
+    settings.minSignalSize = window;
+    settings.maxSignalSize = window;
+    settings.interpolate = interpolate;
+    settings.logPath = logPath;
+    settings.haarPath = HAAR_CLASSIFIER_PATH;
+    settings.dnnProtoPath = DNN_PROTO_PATH;
+    settings.dnnModelPath = DNN_MODEL_PATH;
+
+    RPPG rppg = RPPG();
+    rppg.load(settings);
+
+    video.rewind();
+
+    Mat frameRGB, frameGray;
+    int64_t time;
+    int64 preprocess = 0, wall = 0;
+    int frames = 0, faceFrames = 0, estimates = 0;
+    double errorSum = 0, absSum = 0, squareSum = 0;
+    double firstEstimate = NAN;
+
+    while (video.read(frameRGB, time)) {
+
+        const int64 start = getTickCount();
+
+        cvtColor(frameRGB, frameGray, COLOR_BGR2GRAY);
+        equalizeHist(frameGray, frameGray);
+        preprocess += getTickCount() - start;
+
+        rppg.processFrame(frameRGB, frameGray, time);
+        wall += getTickCount() - start;
+
+        frames++;
+        if (rppg.isFaceValid()) faceFrames++;
+
+        // Score each sampled heart rate against the ground truth
+        if (rppg.getLastSamplingTime() == time && time > 0) {
+            const double error = rppg.getMeanBpm() - video.getBpm();
+            errorSum += error;
+            absSum += fabs(error);
+            squareSum += error * error;
+            estimates++;
+            if (std::isnan(firstEstimate) && fabs(error) <= FIRST_ESTIMATE_ERROR) {
+                firstEstimate = time * TIME_BASE;
+            }
+        }
+    }
+
+    rppg.exit();
+
+    const RPPG::StageTimes &stages = rppg.getStageTimes();
+    const double seconds = wall / getTickFrequency();
+
+    json << "    {\"rppg\": \"" << RPPG_NAMES[rPPGAlg] << "\", "
+         << "\"facedet\": \"" << FACEDET_NAMES[faceDetAlg] << "\", "
+         << "\"window\": " << window << ", "
+         << "\"interpolate\": " << (interpolate ? "true" : "false") << ",\n"
+         << "     \"frames\": " << frames << ", "
+         << "\"face_rate\": " << number(frames > 0 ? (double)faceFrames / frames : NAN) << ",\n"
+         << "     \"fps\": {\"end_to_end\": " << number(frames / seconds) << ", "
+         << "\"process_frame\": " << number(frames / (stages.total / getTickFrequency())) << "},\n"
+         << "     \"stage_ms_per_frame\": {"
+         << "\"preprocess\": " << number(ms(preprocess, frames)) << ", "
+         << "\"face\": " << number(ms(stages.face, frames)) << ", "
+         << "\"sample\": " << number(ms(stages.sample, frames)) << ", "
+         << "\"extract\": " << number(ms(stages.extract, frames)) << ", "
+         << "\"estimate\": " << number(ms(stages.estimate, frames)) << ", "
+         << "\"emit\": " << number(ms(stages.emit, frames)) << ", "
+         << "\"total\": " << number(ms(wall, frames)) << "},\n"
+         << "     \"accuracy\": {\"estimates\": " << estimates << ", "
+         << "\"mae\": " << number(estimates > 0 ? absSum / estimates : NAN) << ", "
+         << "\"rmse\": " << number(estimates > 0 ? sqrt(squareSum / estimates) : NAN) << ", "
+         << "\"bias\": " << number(estimates > 0 ? errorSum / estimates : NAN) << ", "
+         << "\"first_estimate_s\": " << number(firstEstimate) << "}}";
+}
+
+// Green window of a subject: pulse, sensor noise, drift and a rescan step halfway
+static void subjectWindow(RNG &rng, double fps, int n, double bpm, double amplitude, double noise,
+                          Mat1f &green, Mat1b &rescans) {
+    green.create(n, 1);
+    rescans = Mat1b::zeros(n, 1);
+    for (int i = 0; i < n; i++) {
+        const double t = i / fps;
+        green(i, 0) = (float)(128 + amplitude * sin(2 * CV_PI * bpm / 60 * t) + rng.gaussian(noise) + 0.5 * t + (i >= n / 2 ? 8 : 0));
+    }
+    rescans(n / 2, 0) = 1;
+}
+
+// Heart rate of many subjects: independent g pipelines per subject against
+// one batched pipeline with a SIMD lane per subject
+static void runSubjects(int subjects, double fps, int window, double bpm,
+                        double amplitude, double noise, ostream &json) {
+
+    const int n = (int)(fps * window);
+    const int low = (int)(n * LOW_BPM / 60.0 / fps);
+    const int high = min((int)(n * HIGH_BPM / 60.0 / fps) + 1, n / 2);
+
+    RNG rng(0x5eed);
+    vector<Mat1f> greens(subjects);
+    vector<Mat1b> rescans(subjects);
+    vector<double> truth(subjects);
+    for (int j = 0; j < subjects; j++) {
+        truth[j] = bpm + (j % (2 * SUBJECT_BPM_SPREAD + 1)) - SUBJECT_BPM_SPREAD;
+        subjectWindow(rng, fps, n, truth[j], amplitude, noise, greens[j], rescans[j]);
+    }
+
+    // Independent: the g extractor and periodogram estimator per subject
+    vector<double> independent(subjects);
+    Mat1f den, nrm, det, mav, spectrum;
+    int64 start = getTickCount();
+    for (int round = 0; round < DSP_ROUNDS; round++) {
+        for (int j = 0; j < subjects; j++) {
+            denoise(greens[j], rescans[j], den);
+            normalization(den, nrm);
+            detrend(nrm, det, (int)fps);
+            movingAverage(det, mav, 3, fmax(floor(fps / 6), 2));
+            timeToFrequency(mav, spectrum, true);
+            const int bandLow = min(low, spectrum.rows - 1);
+            Point peak;
+            minMaxLoc(spectrum.rowRange(bandLow, min(high + 1, spectrum.rows)), NULL, NULL, NULL, &peak);
+            peak.y += bandLow;
+            independent[j] = (peak.y + interpolatePeak(spectrum, peak.y)) * fps / spectrum.rows * 60;
+        }
+    }
+    const double independentSeconds = (getTickCount() - start) / getTickFrequency();
+
+    // Batched: queue every subject and estimate them together
+    StreamBatch batch;
+    vector<StreamEstimate> batched;
+    start = getTickCount();
+    for (int round = 0; round < DSP_ROUNDS; round++) {
+        for (int j = 0; j < subjects; j++) {
+            batch.add(j, greens[j].ptr<float>(), rescans[j].ptr<uchar>(), n, fps);
+        }
+        batch.run(batched);
+    }
+    const double batchedSeconds = (getTickCount() - start) / getTickFrequency();
+
+    double difference = 0, absSum = 0;
+    for (int j = 0; j < subjects; j++) {
+        difference = max(difference, fabs(batched[j].bpm - independent[j]));
+        absSum += fabs(batched[j].bpm - truth[j]);
+    }
+
+    const double independentRate = subjects * DSP_ROUNDS / independentSeconds;
+    const double batchedRate = subjects * DSP_ROUNDS / batchedSeconds;
+
+    json << "    {\"subjects\": " << subjects << ", \"window\": " << window << ", \"samples\": " << n << ",\n"
+         << "     \"estimations_per_s\": {\"independent\": " << number(independentRate) << ", "
+         << "\"batched\": " << number(batchedRate) << ", "
+         << "\"speedup\": " << number(batchedRate / independentRate) << "},\n"
+         << "     \"max_bpm_difference\": " << number(difference) << ", "
+         << "\"mae\": " << number(absSum / subjects) << "}";
+}
+
+// Time per call of every DSP kernel on one window, for each instruction set
+static void runKernels(double fps, int window, ostream &json) {
+
+    const int n = (int)(fps * window);
+    const int s = (int)fmax(floor(fps / 6), 2);
+    const int low = (int)(n * LOW_BPM / 60.0 / fps);
+    const int high = min((int)(n * HIGH_BPM / 60.0 / fps) + 1, n / 2);
+
+    RNG rng(0x5eed);
+    Mat1f green;
+    Mat1b rescans;
+    subjectWindow(rng, fps, n, DEFAULT_BPM, DEFAULT_AMPLITUDE, DEFAULT_NOISE, green, rescans);
+    vector<float> a(green.begin(), green.end()), b(n), c(n);
+    vector<unsigned char> jumps(rescans.begin(), rescans.end());
+
+    // Lanes of the same window, restored before each lane kernel
+    vector<float> source((size_t)n * KERNEL_LANES), block, mag((size_t)(high - low + 1) * KERNEL_LANES);
+    vector<unsigned char> blockJumps((size_t)n * KERNEL_LANES);
+    for (int i = 0; i < n; i++) {
+        for (int k = 0; k < KERNEL_LANES; k++) {
+            source[(size_t)i * KERNEL_LANES + k] = a[i];
+            blockJumps[(size_t)i * KERNEL_LANES + k] = jumps[i];
+        }
+    }
+
+    const dsp::Isa isas[] = {dsp::SCALAR, dsp::SSE2, dsp::AVX2};
+    const dsp::Isa best = dsp::isa();
+    bool first = true;
+
+    for (dsp::Isa isa : isas) {
+
+        dsp::setIsa(isa);
+        if (dsp::isa() != isa) continue;
+
+        if (!first) json << ",\n";
+        first = false;
+
+        json << "    {\"isa\": \"" << dsp::isaName() << "\", \"samples\": " << n
+             << ", \"lanes\": " << KERNEL_LANES << ",\n"
+             << "     \"ns_per_call\": {";
+
+        // Kernels with their own output time repeated calls on the same input
+        double mean, stdDev;
+        int64 start;
+#define TIME_KERNEL(name, call) \
+        start = getTickCount(); \
+        for (int k = 0; k < KERNEL_CALLS; k++) { call; } \
+        json << "\"" name "\": " << number((getTickCount() - start) * 1e9 / getTickFrequency() / KERNEL_CALLS)
+
+        TIME_KERNEL("meanStdDev", dsp::meanStdDev(a.data(), n, mean, stdDev)) << ", ";
+        TIME_KERNEL("normalize", dsp::normalize(a.data(), b.data(), n)) << ", ";
+        TIME_KERNEL("removeJumps", dsp::removeJumps(a.data(), jumps.data(), b.data(), n)) << ", ";
+        TIME_KERNEL("boxFilter", dsp::boxFilter(a.data(), b.data(), n, s)) << ", ";
+        TIME_KERNEL("weightedSum", dsp::weightedSum(a.data(), 1, b.data(), -0.5f, c.data(), n)) << ", ";
+        TIME_KERNEL("magnitude", dsp::magnitude(a.data(), b.data(), n / 2)) << ",\n                     ";
+
+        // Lane kernels work in place
+        block = source;
+        TIME_KERNEL("removeJumpsLanes", dsp::removeJumpsLanes(block.data(), blockJumps.data(), n, KERNEL_LANES)) << ", ";
+        block = source;
+        TIME_KERNEL("normalizeLanes", dsp::normalizeLanes(block.data(), n, KERNEL_LANES)) << ", ";
+        TIME_KERNEL("detrendLanes", dsp::detrendLanes(block.data(), n, KERNEL_LANES, (int)fps)) << ", ";
+        block = source;
+        dsp::normalizeLanes(block.data(), n, KERNEL_LANES);
+        TIME_KERNEL("boxFilterLanes", dsp::boxFilterLanes(block.data(), n, KERNEL_LANES, s)) << ", ";
+        TIME_KERNEL("bandMagnitudeLanes", dsp::bandMagnitudeLanes(block.data(), n, KERNEL_LANES, low, high, mag.data())) << "}}";
+#undef TIME_KERNEL
+    }
+
+    dsp::setIsa(best);
+}
+
+int main(int argc, char * argv[]) {
+
+    // Configurations
+    vector<rPPGAlgorithm> rPPGAlgs;
+    vector<string> names = split(getArg(argc, argv, "-rppg", DEFAULT_RPPG_ALGORITHMS));
+    for (size_t i = 0; i < names.size(); i++) {
+        rPPGAlgs.push_back((rPPGAlgorithm)indexOf(RPPG_NAMES, 5, names[i], "rPPG algorithm"));
+    }
+
+    vector<faceDetAlgorithm> faceDetAlgs;
+    names = split(getArg(argc, argv, "-facedet", DEFAULT_FACEDET_ALGORITHMS));
+    for (size_t i = 0; i < names.size(); i++) {
+        faceDetAlgs.push_back((faceDetAlgorithm)indexOf(FACEDET_NAMES, 2, names[i], "face detection algorithm"));
+    }
+
+    vector<int> windows;
+    names = split(getArg(argc, argv, "-windows", DEFAULT_WINDOWS));
+    for (size_t i = 0; i < names.size(); i++) {
+        windows.push_back(atoi(names[i].c_str()));
+        if (windows.back() <= 0) {
+            cerr << "Please specify valid windows!" << endl;
+            exit(0);
+        }
+    }
+
+    vector<bool> interpolations;
+    names = split(getArg(argc, argv, "-interpolate", DEFAULT_INTERPOLATE));
+    for (size_t i = 0; i < names.size(); i++) {
+        if (names[i] != "true" && names[i] != "false") {
+            cerr << "Please specify valid interpolation (true, false)!" << endl;
+            exit(0);
+        }
+        interpolations.push_back(names[i] == "true");
+    }
+
+    // Synthetic video
+    const int width = atoi(getArg(argc, argv, "-width", to_string(DEFAULT_WIDTH)).c_str());
+    const int height = atoi(getArg(argc, argv, "-height", to_string(DEFAULT_HEIGHT)).c_str());
+    const double fps = atof(getArg(argc, argv, "-fps", to_string(DEFAULT_FPS)).c_str());
+    const double duration = atof(getArg(argc, argv, "-duration", to_string(DEFAULT_DURATION)).c_str());
+    const double bpm = atof(getArg(argc, argv, "-bpm", to_string(DEFAULT_BPM)).c_str());
+    const string waveformName = getArg(argc, argv, "-waveform", DEFAULT_WAVEFORM);
+    const double amplitude = atof(getArg(argc, argv, "-amplitude", to_string(DEFAULT_AMPLITUDE)).c_str());
+    const double motion = atof(getArg(argc, argv, "-motion", to_string(DEFAULT_MOTION)).c_str());
+    const double noise = atof(getArg(argc, argv, "-noise", to_string(DEFAULT_NOISE)).c_str());
+    const double drift = atof(getArg(argc, argv, "-drift", to_string(DEFAULT_DRIFT)).c_str());
+    const string logPath = getArg(argc, argv, "-logpath", DEFAULT_LOG_PATH);
+    const int subjects = atoi(getArg(argc, argv, "-subjects", to_string(DEFAULT_SUBJECTS)).c_str());
+    const string output = getArg(argc, argv, "-o", "");
+
+    pulseWaveform waveform;
+    if (waveformName == "sine") {
+        waveform = sine;
+    } else if (waveformName == "physiological") {
+        waveform = physiological;
+    } else {
+        cerr << "Please specify valid waveform!" << endl;
+        exit(0);
+    }
+
+    if (width <= 0 || height <= 0 || fps <= 0 || duration <= 0 || bpm <= 0) {
+        cerr << "Please specify valid video settings!" << endl;
+        exit(0);
+    }
+
+    SyntheticVideo video;
+    video.load(width, height, fps, duration, bpm, waveform, amplitude, motion, noise, drift);
+
+    ostringstream json;
+    json << "{\n"
+         << "  \"build\": {\"optimized\": "
+#ifdef __OPTIMIZE__
+         << "true"
+#else
+         << "false"
+#endif
+         << ", \"compiler\": \"" << __VERSION__ << "\", \"isa\": \"" << dsp::isaName() << "\"},\n"
+         << "  \"video\": {\"width\": " << width << ", \"height\": " << height
+         << ", \"fps\": " << number(fps) << ", \"duration\": " << number(duration)
+         << ", \"bpm\": " << number(bpm) << ", \"waveform\": \"" << waveformName << "\""
+         << ", \"amplitude\": " << number(amplitude) << ", \"motion\": " << number(motion)
+         << ", \"noise\": " << number(noise) << ", \"drift\": " << number(drift) << "},\n"
+         << "  \"results\": [\n";
+
+    bool first = true;
+    for (size_t d = 0; d < faceDetAlgs.size(); d++) {
+
+        const bool available = faceDetAlgs[d] == haar ? exists(HAAR_CLASSIFIER_PATH)
+                                                      : exists(DNN_PROTO_PATH) && exists(DNN_MODEL_PATH);
+
+        for (size_t r = 0; r < rPPGAlgs.size(); r++) {
+            for (size_t w = 0; w < windows.size(); w++) {
+                for (size_t k = 0; k < interpolations.size(); k++) {
+
+                    if (!first) json << ",\n";
+                    first = false;
+
+                    cerr << "Benchmarking -rppg " << RPPG_NAMES[rPPGAlgs[r]]
+                         << " -facedet " << FACEDET_NAMES[faceDetAlgs[d]]
+                         << " -max " << windows[w]
+                         << " -interpolate " << (interpolations[k] ? "true" : "false") << endl;
+
+                    if (!available) {
+                        json << "    {\"rppg\": \"" << RPPG_NAMES[rPPGAlgs[r]] << "\", "
+                             << "\"facedet\": \"" << FACEDET_NAMES[faceDetAlgs[d]] << "\", "
+                             << "\"window\": " << windows[w] << ", "
+                             << "\"interpolate\": " << (interpolations[k] ? "true" : "false") << ", "
+                             << "\"skipped\": \"model files not found\"}";
+                        continue;
+                    }
+
+                    // Keep the pipeline quiet while timing
+                    QuietConsole quiet;
+                    run(video, rPPGAlgs[r], faceDetAlgs[d], windows[w], interpolations[k], logPath, json);
+                }
+            }
+        }
+    }
+
+    json << "\n  ],\n"
+         << "  \"dsp_batch\": [\n";
+
+    // Per-core capacity of the DSP stage for many subjects
+    for (size_t w = 0; w < windows.size() && subjects > 0; w++) {
+
+        if (w > 0) json << ",\n";
+
+        cerr << "Benchmarking " << subjects << " subjects -max " << windows[w] << endl;
+        runSubjects(subjects, fps, windows[w], bpm, amplitude, noise, json);
+    }
+
+    json << "\n  ],\n"
+         << "  \"dsp_kernels\": [\n";
+
+    // Kernels on the largest window
+    cerr << "Benchmarking DSP kernels -max " << windows.back() << endl;
+    runKernels(fps, windows.back(), json);
+
+    json << "\n  ]\n}\n";
+
+    if (output.empty()) {
+        cout << json.str();
+    } else {
+        ofstream file(output);
+        file << json.str();
+    }
+
+    return 0;
+}
@@ -0,0 +1,591 @@
+//
+//  Check.cpp
+//  Heartbeat
+//
+//  Created by Philipp Rouast on 19/10/2026.
+//  Copyright © 2026 Philipp Roüast. All rights reserved.
+//
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "dsp.hpp"
+#include "opencv.hpp"
+#include "RPPG.hpp"
+#include "StreamBatch.hpp"
+
+#define CHECK_SAMPLES 300 // 10 s at 30 fps
+#define CHECK_LAMBDA 30
+#define CHECK_SMOOTH 5
+#define CHECK_LANES 16
+#define CHECK_SEED 0x5eed
+#define CHECK_WINDOW 150 // 5 s at 30 fps
+#define CHECK_HOP 3
+#define CHECK_PCA_ANGLE 0.1 // as PCA_MAX_ANGLE in RPPG.cpp
+#define CHECK_FPS 30
+#define ALLOCATION_WARMUP 600 // frames until the 10 s window is full and every cache is warm
+#define ALLOCATION_FRAMES 300 // steady-state frames counted
+#define CHECK_SUBJECTS 11 // per window, not a multiple of the lane width
+
+// Largest error relative to the reference, scaled by its magnitude
+#define ELEMENT_TOLERANCE 1e-5 // elementwise kernels, a few float roundings
+#define DETREND_TOLERANCE 1e-5 // double solve, float input and output
+#define SPECTRUM_TOLERANCE 1e-4 // float accumulation over the window
+#define PCA_TOLERANCE 1e-5 // same covariance and solve, float projection
+#define TRANSFORM_TOLERANCE 1e-5 // same transform, planned once instead of per call
+#define BPM_TOLERANCE 0.01 // bpm, the band spectrum within SPECTRUM_TOLERANCE moves the refined peak
+#define SNR_TOLERANCE 0.01 // dB
+
+using namespace cv;
+using namespace std;
+
+static int failures = 0;
+
+static void expect(const string &name, double error, double tolerance) {
+    const bool pass = error <= tolerance;
+    printf("%-4s %-44s error %.3g, tolerance %.3g\n", pass ? "ok" : "FAIL", name.c_str(), error, tolerance);
+    if (!pass) failures++;
+}
+
+// Largest difference over the largest reference magnitude, at least 1
+static double relativeError(const float *a, const vector<double> &reference) {
+    double error = 0, scale = 1;
+    for (size_t i = 0; i < reference.size(); i++) {
+        error = max(error, fabs(a[i] - reference[i]));
+        scale = max(scale, fabs(reference[i]));
+    }
+    return std::isfinite(error) ? error / scale : INFINITY;
+}
+
+/* DOUBLE REFERENCES */
+
+static void referenceMeanStdDev(const vector<float> &a, double &mean, double &stdDev) {
+    mean = 0;
+    for (size_t i = 0; i < a.size(); i++) mean += a[i];
+    mean /= a.size();
+    stdDev = 0;
+    for (size_t i = 0; i < a.size(); i++) stdDev += (a[i] - mean) * (a[i] - mean);
+    stdDev = sqrt(stdDev / a.size());
+}
+
+static vector<double> referenceNormalize(const vector<float> &a) {
+    double mean, stdDev;
+    referenceMeanStdDev(a, mean, stdDev);
+    vector<double> b(a.size());
+    for (size_t i = 0; i < a.size(); i++) b[i] = (a[i] - mean) / stdDev;
+    return b;
+}
+
+static vector<double> referenceRemoveJumps(const vector<float> &a, const vector<unsigned char> &jumps) {
+    vector<double> b(a.size());
+    double offset = 0;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (i > 0 && jumps[i]) offset += (double)a[i] - a[i-1];
+        b[i] = a[i] - offset;
+    }
+    return b;
+}
+
+// cv::blur with BORDER_REFLECT_101
+static vector<double> referenceBoxFilter(const vector<float> &a, int s) {
+    const int n = (int)a.size();
+    vector<double> b(n);
+    for (int i = 0; i < n; i++) {
+        double sum = 0;
+        for (int k = 0; k < s; k++) {
+            int p = i - s / 2 + k;
+            while (p < 0 || p >= n) p = p < 0 ? -p : 2 * n - 2 - p;
+            sum += a[p];
+        }
+        b[i] = sum / s;
+    }
+    return b;
+}
+
+// a - (I + λ^2 * D2^t*D2)^-1 * a by dense Gaussian elimination
+static vector<double> referenceDetrend(const vector<float> &a, int lambda) {
+    const int n = (int)a.size();
+    const double l = (double)lambda * lambda;
+    vector<vector<double> > m(n, vector<double>(n + 1, 0));
+    for (int i = 0; i < n; i++) {
+        m[i][i] = 1;
+        m[i][n] = a[i];
+    }
+    for (int k = 0; k < n - 2; k++) {
+        const int rows[] = {k, k + 1, k + 2};
+        const double d[] = {1, -2, 1};
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) m[rows[i]][rows[j]] += l * d[i] * d[j];
+        }
+    }
+    for (int c = 0; c < n; c++) {
+        for (int r = c + 1; r < min(c + 3, n); r++) {
+            const double f = m[r][c] / m[c][c];
+            for (int j = c; j <= n; j++) m[r][j] -= f * m[c][j];
+        }
+    }
+    vector<double> x(n);
+    for (int r = n - 1; r >= 0; r--) {
+        double v = m[r][n];
+        for (int j = r + 1; j < n; j++) v -= m[r][j] * x[j];
+        x[r] = v / m[r][r];
+    }
+    vector<double> b(n);
+    for (int i = 0; i < n; i++) b[i] = a[i] - x[i];
+    return b;
+}
+
+static double referenceBinMagnitude(const vector<float> &a, int bin) {
+    const int n = (int)a.size();
+    double re = 0, im = 0;
+    for (int i = 0; i < n; i++) {
+        re += a[i] * cos(2 * M_PI * (double)bin * i / n);
+        im += a[i] * sin(2 * M_PI * (double)bin * i / n);
+    }
+    return sqrt(re * re + im * im);
+}
+
+/* INPUTS */
+
+// Skin level, pulse, drift, noise and rescan steps
+static void pulseSignal(mt19937 &rng, int n, vector<float> &a, vector<unsigned char> &jumps) {
+    normal_distribution<double> noise(0, 1);
+    uniform_real_distribution<double> uniform(0, 1);
+    const double level = 60 + 120 * uniform(rng), bpm = 50 + 100 * uniform(rng);
+    a.resize(n);
+    jumps.assign(n, 0);
+    double step = 0;
+    for (int i = 0; i < n; i++) {
+        if (i > 0 && uniform(rng) < 0.02) {
+            jumps[i] = 1;
+            step += 10 * noise(rng);
+        }
+        const double t = i / 30.0;
+        a[i] = (float)(level + step + 2 * sin(2 * M_PI * bpm / 60 * t) + 0.5 * t + noise(rng));
+    }
+}
+
+// Lanes of independent signals in structure-of-arrays layout
+static void lanes(mt19937 &rng, int n, int count, vector<vector<float> > &signals,
+                  vector<vector<unsigned char> > &jumps, vector<float> &block, vector<unsigned char> &blockJumps) {
+    signals.resize(count);
+    jumps.resize(count);
+    block.resize((size_t)n * count);
+    blockJumps.resize((size_t)n * count);
+    for (int k = 0; k < count; k++) {
+        pulseSignal(rng, n, signals[k], jumps[k]);
+        for (int i = 0; i < n; i++) {
+            block[(size_t)i * count + k] = signals[k][i];
+            blockJumps[(size_t)i * count + k] = jumps[k][i];
+        }
+    }
+}
+
+static vector<float> lane(const vector<float> &block, int n, int count, int k) {
+    vector<float> a(n);
+    for (int i = 0; i < n; i++) a[i] = block[(size_t)i * count + k];
+    return a;
+}
+
+/* DSP KERNELS
+ *
+ * Every kernel on every instruction set the CPU supports, against a double
+ * precision implementation of the same operation. */
+
+static void checkKernels() {
+
+    const string prefix = string("dsp ") + dsp::isaName() + " ";
+    const int n = CHECK_SAMPLES;
+
+    mt19937 rng(CHECK_SEED);
+    vector<float> a, b, out(n);
+    vector<unsigned char> jumps, unused;
+    pulseSignal(rng, n, a, jumps);
+    pulseSignal(rng, n, b, unused);
+
+    double mean, stdDev, refMean, refStdDev;
+    dsp::meanStdDev(a.data(), n, mean, stdDev);
+    referenceMeanStdDev(a, refMean, refStdDev);
+    expect(prefix + "meanStdDev", max(fabs(mean - refMean) / fabs(refMean), fabs(stdDev - refStdDev) / refStdDev), ELEMENT_TOLERANCE);
+
+    dsp::normalize(a.data(), out.data(), n);
+    expect(prefix + "normalize", relativeError(out.data(), referenceNormalize(a)), ELEMENT_TOLERANCE);
+
+    dsp::removeJumps(a.data(), jumps.data(), out.data(), n);
+    expect(prefix + "removeJumps", relativeError(out.data(), referenceRemoveJumps(a, jumps)), ELEMENT_TOLERANCE);
+
+    dsp::boxFilter(a.data(), out.data(), n, CHECK_SMOOTH);
+    expect(prefix + "boxFilter", relativeError(out.data(), referenceBoxFilter(a, CHECK_SMOOTH)), ELEMENT_TOLERANCE);
+
+    dsp::weightedSum(a.data(), 1.5f, b.data(), -0.75f, out.data(), n);
+    vector<double> reference(n);
+    for (int i = 0; i < n; i++) reference[i] = 1.5 * a[i] - 0.75 * b[i];
+    expect(prefix + "weightedSum", relativeError(out.data(), reference), ELEMENT_TOLERANCE);
+
+    // a as n / 2 interleaved complex values
+    dsp::magnitude(a.data(), out.data(), n / 2);
+    reference.resize(n / 2);
+    for (int i = 0; i < n / 2; i++) reference[i] = sqrt((double)a[2*i] * a[2*i] + (double)a[2*i+1] * a[2*i+1]);
+    expect(prefix + "magnitude", relativeError(out.data(), reference), ELEMENT_TOLERANCE);
+
+    // Lane kernels on lanes of different signals, each against its own reference
+    vector<vector<float> > signals;
+    vector<vector<unsigned char> > laneJumps;
+    vector<float> block;
+    vector<unsigned char> blockJumps;
+    lanes(rng, n, CHECK_LANES, signals, laneJumps, block, blockJumps);
+
+    double error = 0;
+    dsp::removeJumpsLanes(block.data(), blockJumps.data(), n, CHECK_LANES);
+    for (int k = 0; k < CHECK_LANES; k++) {
+        error = max(error, relativeError(lane(block, n, CHECK_LANES, k).data(), referenceRemoveJumps(signals[k], laneJumps[k])));
+        signals[k] = lane(block, n, CHECK_LANES, k);
+    }
+    expect(prefix + "removeJumpsLanes", error, ELEMENT_TOLERANCE);
+
+    error = 0;
+    dsp::normalizeLanes(block.data(), n, CHECK_LANES);
+    for (int k = 0; k < CHECK_LANES; k++) {
+        error = max(error, relativeError(lane(block, n, CHECK_LANES, k).data(), referenceNormalize(signals[k])));
+        signals[k] = lane(block, n, CHECK_LANES, k);
+    }
+    expect(prefix + "normalizeLanes", error, ELEMENT_TOLERANCE);
+
+    error = 0;
+    dsp::detrendLanes(block.data(), n, CHECK_LANES, CHECK_LAMBDA);
+    for (int k = 0; k < CHECK_LANES; k++) {
+        error = max(error, relativeError(lane(block, n, CHECK_LANES, k).data(), referenceDetrend(signals[k], CHECK_LAMBDA)));
+        signals[k] = lane(block, n, CHECK_LANES, k);
+    }
+    expect(prefix + "detrendLanes", error, DETREND_TOLERANCE);
+
+    error = 0;
+    dsp::boxFilterLanes(block.data(), n, CHECK_LANES, CHECK_SMOOTH);
+    for (int k = 0; k < CHECK_LANES; k++) {
+        error = max(error, relativeError(lane(block, n, CHECK_LANES, k).data(), referenceBoxFilter(signals[k], CHECK_SMOOTH)));
+        signals[k] = lane(block, n, CHECK_LANES, k);
+    }
+    expect(prefix + "boxFilterLanes", error, ELEMENT_TOLERANCE);
+
+    // The heart rate band of the window
+    const int low = n * 42 / 60 / 30, high = n * 240 / 60 / 30 + 1;
+    vector<float> mag((size_t)(high - low + 1) * CHECK_LANES);
+    dsp::bandMagnitudeLanes(block.data(), n, CHECK_LANES, low, high, mag.data());
+    error = 0;
+    for (int k = 0; k < CHECK_LANES; k++) {
+        reference.resize(high - low + 1);
+        for (int bin = low; bin <= high; bin++) reference[bin - low] = referenceBinMagnitude(signals[k], bin);
+        error = max(error, relativeError(lane(mag, high - low + 1, CHECK_LANES, k).data(), reference));
+    }
+    expect(prefix + "bandMagnitudeLanes", error, SPECTRUM_TOLERANCE);
+
+}
+
+/* STREAMING PCA
+ *
+ * Batch and streaming component selection on the same sliding windows,
+ * normalized and detrended as in the pca pipeline. A fresh selection and every
+ * rescored one must be the batch component; the others must still be one of
+ * the batch eigenvectors, up to sign. */
+
+// Smallest difference of a to b or -b over the largest magnitude of b, at least 1
+static double signedError(const Mat1f &a, const Mat1f &b) {
+    double plus = 0, minus = 0, scale = 1;
+    for (int i = 0; i < b.rows; i++) {
+        plus = max(plus, (double)fabs(a(i) - b(i)));
+        minus = max(minus, (double)fabs(a(i) + b(i)));
+        scale = max(scale, (double)fabs(b(i)));
+    }
+    return min(plus, minus) / scale;
+}
+
+static void checkPca() {
+
+    // BGR means: a pulse mostly in green, drifting channels, camera noise
+    mt19937 rng(CHECK_SEED);
+    normal_distribution<float> noise(0, 0.3f);
+    Mat1f means(CHECK_SAMPLES, 3);
+    for (int i = 0; i < CHECK_SAMPLES; i++) {
+        const float t = i / 30.0f;
+        const float pulse = sinf(2 * (float)M_PI * 1.2f * t);
+        means(i, 0) = 90 + 0.3f * pulse + 0.02f * t + noise(rng);
+        means(i, 1) = 120 + 1.0f * pulse - 0.05f * t + noise(rng);
+        means(i, 2) = 160 + 0.5f * pulse + 0.03f * t * t + noise(rng);
+    }
+
+    const int low = CHECK_WINDOW * 42 / 60 / 30, high = CHECK_WINDOW * 240 / 60 / 30 + 1;
+    StreamingPCA tracking;
+    Mat normalized, window, batch, batchPc, fresh, freshPc, tracked;
+    double freshError = 0, rescoredError = 0, trackedError = 0;
+    int rescored = 0, total = 0;
+    for (int start = 0; start + CHECK_WINDOW <= CHECK_SAMPLES; start += CHECK_HOP) {
+
+        normalization(means.rowRange(start, start + CHECK_WINDOW), normalized);
+        detrend(normalized, window, CHECK_LAMBDA);
+
+        pcaComponent(window, batch, batchPc, low, high);
+
+        StreamingPCA first;
+        first.component(window, fresh, freshPc, low, high, CHECK_PCA_ANGLE);
+        freshError = max(freshError, signedError(fresh, batch));
+        for (int k = 0; k < 3; k++) {
+            freshError = max(freshError, signedError(freshPc.col(k), batchPc.col(k)));
+        }
+
+        tracking.component(window, tracked, noArray(), low, high, CHECK_PCA_ANGLE);
+        if (tracking.wasRescored()) {
+            rescoredError = max(rescoredError, signedError(tracked, batch));
+            rescored++;
+        } else {
+            double error = INFINITY;
+            for (int k = 0; k < 3; k++) {
+                error = min(error, signedError(tracked, batchPc.col(k)));
+            }
+            trackedError = max(trackedError, error);
+        }
+        total++;
+    }
+
+    expect("pca fresh selection vs batch", freshError, PCA_TOLERANCE);
+    expect("pca rescored selection vs batch", rescoredError, PCA_TOLERANCE);
+    expect("pca tracked selection is a batch component", trackedError, PCA_TOLERANCE);
+    printf("     %d of %d windows rescored\n", rescored, total);
+}
+
+/* TRANSFORMS
+ *
+ * The planned real transforms against cv::dft, for an even and an odd length. */
+
+// Largest difference over the largest magnitude of the reference, at least 1
+static double matError(const Mat &a, const Mat &reference) {
+    return cv::norm(a, reference, NORM_INF) / max(1.0, cv::norm(reference, NORM_INF));
+}
+
+static void checkTransforms() {
+
+    mt19937 rng(CHECK_SEED);
+    normal_distribution<float> noise(0, 1);
+    const int lengths[] = {CHECK_WINDOW, CHECK_WINDOW + 1};
+    for (int n : lengths) {
+
+        Mat1f a(n, 1);
+        for (int i = 0; i < n; i++) a(i) = noise(rng);
+
+        Mat spectrum, reference;
+        timeToFrequency(a, spectrum, false);
+        dft(a, reference);
+        expect("timeToFrequency vs cv::dft, n=" + to_string(n), matError(spectrum, reference), TRANSFORM_TOLERANCE);
+
+        Mat signal, inverse;
+        frequencyToTime(reference, signal);
+        dft(reference, inverse, DFT_INVERSE | DFT_REAL_OUTPUT);
+        normalize(inverse, inverse, 0, 1, NORM_MINMAX);
+        expect("frequencyToTime vs cv::dft, n=" + to_string(n), matError(signal, inverse), TRANSFORM_TOLERANCE);
+    }
+}
+
+/* ALLOCATIONS
+ *
+ * Every algorithm is fed synthetic trace samples until its window is full,
+ * then the following frames must not allocate. Every operator new of the
+ * process is counted while counting is set, OpenCV's Mat storage included. */
+
+static atomic<bool> counting(false);
+static atomic<long> allocations(0);
+
+void *operator new(size_t size) {
+    if (counting) allocations++;
+    void *p = malloc(size > 0 ? size : 1);
+    if (!p) throw bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+// BGR means of a 72 bpm pulse with drift, noise and a rescan every second
+static TraceSample traceSample(mt19937 &rng, int i) {
+    normal_distribution<float> noise(0, 0.3f);
+    const float t = (float)i / CHECK_FPS;
+    const float pulse = sinf(2 * (float)M_PI * 1.2f * t);
+    TraceSample sample;
+    sample.time = (int64_t)(i * 1000.0 / CHECK_FPS + 0.5);
+    sample.values[0] = 90 + 0.3f * pulse + 0.02f * t + noise(rng);
+    sample.values[1] = 120 + 1.0f * pulse - 0.05f * t + noise(rng);
+    sample.values[2] = 160 + 0.5f * pulse + noise(rng);
+    sample.motion = 0;
+    sample.faceValid = true;
+    sample.rescan = i % CHECK_FPS == 0;
+    sample.saturated = false;
+    return sample;
+}
+
+struct AllocationCase {
+    const char *name;
+    rPPGAlgorithm rPPGAlg;
+    bandpassAlgorithm bandpassAlg;
+    pcaAlgorithm pcaAlg;
+    estimatorAlgorithm estimatorAlg;
+};
+
+static void checkAllocations() {
+
+    const AllocationCase cases[] = {
+        {"g", g, fft, batch, periodogram},
+        {"g welch", g, fft, batch, welch},
+        {"pca batch", pca, fft, batch, periodogram},
+        {"pca tracked", pca, fft, tracked, periodogram},
+        {"xminay fft", xminay, fft, batch, periodogram},
+        {"xminay iir", xminay, iir, batch, periodogram},
+        {"xminay iir welch", xminay, iir, batch, welch},
+        {"pos", pos, fft, batch, periodogram},
+        {"chrom", chrom, fft, batch, periodogram},
+    };
+
+    for (const AllocationCase &c : cases) {
+
+        RPPGSettings settings;
+        settings.rPPGAlg = c.rPPGAlg;
+        settings.bandpassAlg = c.bandpassAlg;
+        settings.pcaAlg = c.pcaAlg;
+        settings.estimatorAlg = c.estimatorAlg;
+        settings.minSignalSize = 5;
+        settings.maxSignalSize = 10;
+
+        RPPG rppg;
+        mt19937 rng(CHECK_SEED);
+        {
+            QuietConsole quiet;
+            rppg.load(settings);
+            for (int i = 0; i < ALLOCATION_WARMUP + ALLOCATION_FRAMES; i++) {
+                const TraceSample sample = traceSample(rng, i);
+                if (i == ALLOCATION_WARMUP) {
+                    allocations = 0;
+                    counting = true;
+                }
+                rppg.processTrace(sample);
+            }
+            counting = false;
+        }
+
+        expect(string("allocations per frame, ") + c.name, (double)allocations / ALLOCATION_FRAMES, 0);
+    }
+}
+
+/* STREAM BATCH
+ *
+ * Subjects with windows of two lengths at 30 fps and one at 6 fps, where
+ * the band is cut at the Nyquist bin, each estimated by its own RPPG with
+ * the g extractor and periodogram and by one StreamBatch run. Every subject
+ * must get the same heart rate and SNR from both. */
+
+struct StreamWindow {
+    double fps;
+    int n;
+};
+
+// Trace samples of a subject with a pulse, drift, noise and a rescan step
+static vector<TraceSample> streamSamples(mt19937 &rng, const StreamWindow &w, double bpm) {
+    normal_distribution<float> noise(0, 0.3f);
+    vector<TraceSample> samples(w.n);
+    for (int i = 0; i < w.n; i++) {
+        const float t = (float)(i / w.fps);
+        const float pulse = sinf(2 * (float)M_PI * (float)bpm / 60 * t);
+        TraceSample &sample = samples[i];
+        sample.time = (int64_t)(i * 1000.0 / w.fps + 0.5);
+        sample.values[0] = 90 + noise(rng);
+        sample.values[1] = 120 + pulse + 0.05f * t + noise(rng) + (i >= w.n / 3 ? 6 : 0);
+        sample.values[2] = 160 + noise(rng);
+        sample.motion = 0;
+        sample.faceValid = true;
+        sample.rescan = i == w.n / 3;
+        sample.saturated = false;
+    }
+    return samples;
+}
+
+static void checkStreamBatch() {
+
+    const StreamWindow windows[] = {{CHECK_FPS, CHECK_WINDOW}, {CHECK_FPS, CHECK_WINDOW + 1}, {6, 60}};
+    const int count = (int)(sizeof(windows) / sizeof(windows[0]));
+
+    RPPGSettings settings;
+    settings.rPPGAlg = g;
+    settings.estimatorAlg = periodogram;
+    settings.minSignalSize = 1;
+    settings.maxSignalSize = 1000;
+
+    // Windows interleaved, so the batch has to restore the order
+    mt19937 rng(CHECK_SEED);
+    StreamBatch batch;
+    vector<double> bpms, snrs;
+    for (int j = 0; j < CHECK_SUBJECTS * count; j++) {
+
+        const StreamWindow &w = windows[j % count];
+        const vector<TraceSample> samples = streamSamples(rng, w, 50 + 7 * j % 100);
+
+        RPPG rppg;
+        {
+            QuietConsole quiet;
+            rppg.load(settings);
+            for (const TraceSample &sample : samples) {
+                rppg.processTrace(sample);
+            }
+        }
+        bpms.push_back(rppg.getBpm());
+        snrs.push_back(rppg.getSnr());
+
+        vector<float> green(w.n);
+        vector<unsigned char> rescans(w.n);
+        for (int i = 0; i < w.n; i++) {
+            green[i] = samples[i].values[1];
+            rescans[i] = samples[i].rescan;
+        }
+        batch.add(j, green.data(), rescans.data(), w.n, rppg.getFrameRate());
+    }
+
+    vector<StreamEstimate> estimates;
+    batch.run(estimates);
+
+    double bpmError = 0, snrError = 0, idError = 0;
+    for (size_t j = 0; j < estimates.size(); j++) {
+        bpmError = max(bpmError, fabs(estimates[j].bpm - bpms[j]));
+        snrError = max(snrError, fabs(estimates[j].snr - snrs[j]));
+        idError = max(idError, fabs((double)estimates[j].id - (double)j));
+    }
+    expect("stream batch bpm vs RPPG", bpmError, BPM_TOLERANCE);
+    expect("stream batch snr vs RPPG", snrError, SNR_TOLERANCE);
+    expect("stream batch order", idError, 0);
+}
+
+int main(int, char **) {
+
+    // Every instruction set the CPU supports, the best one last so it stays selected
+    const dsp::Isa isas[] = {dsp::SCALAR, dsp::SSE2, dsp::AVX2};
+    const dsp::Isa best = dsp::isa();
+    for (dsp::Isa isa : isas) {
+        dsp::setIsa(isa);
+        if (dsp::isa() != isa) {
+            printf("skip dsp %s, not supported\n", isa == dsp::AVX2 ? "avx2" : "sse2");
+            continue;
+        }
+        checkKernels();
+    }
+    dsp::setIsa(best);
+
+    checkPca();
+    checkTransforms();
+    checkAllocations();
+    checkStreamBatch();
+
+    printf("%d failed\n", failures);
+    return failures > 0 ? 1 : 0;
+}
@@ -13,14 +13,28 @@
 #include <opencv2/highgui.hpp>
 #include <opencv2/imgproc.hpp>
 #include "opencv.hpp"
+#include "Sweep.hpp"
+#include "Batch.hpp"
+#include "Raw.hpp"
+
+#include <sstream>
+#include <thread>
 
 #define DEFAULT_RPPG_ALGORITHM "g"
 #define DEFAULT_FACEDET_ALGORITHM "haar"
+#define DEFAULT_BANDPASS_ALGORITHM "fft"
+#define DEFAULT_PCA_ALGORITHM "batch"
+#define DEFAULT_ESTIMATOR_ALGORITHM "periodogram"
 #define DEFAULT_RESCAN_FREQUENCY 1
 #define DEFAULT_SAMPLING_FREQUENCY 1
+#define DEFAULT_ESTIMATION_HOP 0 // seconds between estimations, 0 means every frame
+#define DEFAULT_RESAMPLE_RATE 0 // Hz, 0 means no resampling
 #define DEFAULT_MIN_SIGNAL_SIZE 5
 #define DEFAULT_MAX_SIGNAL_SIZE 5
 #define DEFAULT_DOWNSAMPLE 1 // x means only every xth frame is used
+#define DEFAULT_BATCH_SUMMARY "batch_summary.csv"
+#define DEFAULT_LIVE_FPS 30 // if the camera does not report its frame rate
+#define MAX_CAPTURE_AGE 1 // seconds, older capture timestamps are taken to be on another clock
 
 #define HAAR_CLASSIFIER_PATH "haarcascade_frontalface_alt.xml"
 #define DNN_PROTO_PATH "opencv/deploy.prototxt"
@@ -88,8 +102,10 @@ rPPGAlgorithm to_rppgAlgorithm(string s) {
     if (s == "g") result = g;
     else if (s == "pca") result = pca;
     else if (s == "xminay") result = xminay;
+    else if (s == "pos") result = pos;
+    else if (s == "chrom") result = chrom;
     else {
-        std::cout << "Please specify valid rPPG algorithm (g, pca, xminay)!" << std::endl;
+        std::cout << "Please specify valid rPPG algorithm (g, pca, xminay, pos, chrom)!" << std::endl;
         exit(0);
     }
     return result;
@@ -106,10 +122,171 @@ faceDetAlgorithm to_faceDetAlgorithm(string s) {
     return result;
 }
 
+bandpassAlgorithm to_bandpassAlgorithm(string s) {
+    bandpassAlgorithm result;
+    if (s == "fft") result = fft;
+    else if (s == "iir") result = iir;
+    else {
+        std::cout << "Please specify valid bandpass algorithm (fft, iir)!" << std::endl;
+        exit(0);
+    }
+    return result;
+}
+
+pcaAlgorithm to_pcaAlgorithm(string s) {
+    pcaAlgorithm result;
+    if (s == "batch") result = batch;
+    else if (s == "tracked") result = tracked;
+    else {
+        std::cout << "Please specify valid pca algorithm (batch, tracked)!" << std::endl;
+        exit(0);
+    }
+    return result;
+}
+
+estimatorAlgorithm to_estimatorAlgorithm(string s) {
+    estimatorAlgorithm result;
+    if (s == "periodogram") result = periodogram;
+    else if (s == "welch") result = welch;
+    else {
+        std::cout << "Please specify valid estimator algorithm (periodogram, welch)!" << std::endl;
+        exit(0);
+    }
+    return result;
+}
+
+rawFormat to_rawFormat(string s) {
+    rawFormat result;
+    if (s == "bgr24") result = bgr24;
+    else if (s == "gray") result = gray;
+    else if (s == "nv12") result = nv12;
+    else {
+        std::cout << "Please specify valid raw format (bgr24, gray, nv12)!" << std::endl;
+        exit(0);
+    }
+    return result;
+}
+
+// Patch grid as columns x rows
+Size to_patchGrid(string s) {
+    int cols = 0, rows = 0;
+    char separator = 0;
+    istringstream is(s);
+    if (!(is >> cols >> separator >> rows) || separator != 'x' || cols < 1 || rows < 1) {
+        std::cout << "Please specify valid patch grid (e.g. 3x3)!" << std::endl;
+        exit(0);
+    }
+    return Size(cols, rows);
+}
+
+// Comma-separated list setting, or the default
+vector<string> to_list(string s, string fallback) {
+    vector<string> result;
+    stringstream ss(s != "" ? s : fallback);
+    string item;
+    while (getline(ss, item, ',')) {
+        if (item != "") result.push_back(item);
+    }
+    return result;
+}
+
+// Every configuration in configs combined with every value
+template<typename Set>
+vector<SweepConfig> expand(const vector<SweepConfig> &configs, const vector<string> &values, Set set) {
+    vector<SweepConfig> result;
+    for (size_t i = 0; i < configs.size(); i++) {
+        for (size_t j = 0; j < values.size(); j++) {
+            SweepConfig config = configs[i];
+            set(config, values[j]);
+            result.push_back(config);
+        }
+    }
+    return result;
+}
+
+int sweep(Heartbeat &cmd_line, const string &output) {
+
+    string replayPath = cmd_line.get_arg("-replay");
+    if (replayPath == "") {
+        std::cout << "Please specify a trace to sweep with -replay!" << std::endl;
+        exit(0);
+    }
+
+    // Grid of settings, each flag takes a comma-separated list
+    vector<SweepConfig> configs(1);
+    configs = expand(configs, to_list(cmd_line.get_arg("-rppg"), DEFAULT_RPPG_ALGORITHM),
+                     [](SweepConfig &c, const string &v) { c.rPPGAlg = to_rppgAlgorithm(v); });
+    configs = expand(configs, to_list(cmd_line.get_arg("-filter"), DEFAULT_BANDPASS_ALGORITHM),
+                     [](SweepConfig &c, const string &v) { c.bandpassAlg = to_bandpassAlgorithm(v); });
+    configs = expand(configs, to_list(cmd_line.get_arg("-pca"), DEFAULT_PCA_ALGORITHM),
+                     [](SweepConfig &c, const string &v) { c.pcaAlg = to_pcaAlgorithm(v); });
+    configs = expand(configs, to_list(cmd_line.get_arg("-estimator"), DEFAULT_ESTIMATOR_ALGORITHM),
+                     [](SweepConfig &c, const string &v) { c.estimatorAlg = to_estimatorAlgorithm(v); });
+    configs = expand(configs, to_list(cmd_line.get_arg("-min"), to_string(DEFAULT_MIN_SIGNAL_SIZE)),
+                     [](SweepConfig &c, const string &v) { c.minSignalSize = atof(v.c_str()); });
+    configs = expand(configs, to_list(cmd_line.get_arg("-max"), to_string(DEFAULT_MAX_SIGNAL_SIZE)),
+                     [](SweepConfig &c, const string &v) { c.maxSignalSize = atof(v.c_str()); });
+    configs = expand(configs, to_list(cmd_line.get_arg("-f"), to_string(DEFAULT_SAMPLING_FREQUENCY)),
+                     [](SweepConfig &c, const string &v) { c.samplingFrequency = atof(v.c_str()); });
+    configs = expand(configs, to_list(cmd_line.get_arg("-hop"), to_string(DEFAULT_ESTIMATION_HOP)),
+                     [](SweepConfig &c, const string &v) { c.estimationHop = atof(v.c_str()); });
+    configs = expand(configs, to_list(cmd_line.get_arg("-resample"), to_string(DEFAULT_RESAMPLE_RATE)),
+                     [](SweepConfig &c, const string &v) { c.resampleRate = atof(v.c_str()); });
+    configs = expand(configs, to_list(cmd_line.get_arg("-quality"), "false"),
+                     [](SweepConfig &c, const string &v) { c.quality = to_bool(v); });
+
+    // Drop windows that cannot be valid
+    vector<SweepConfig> valid;
+    for (size_t i = 0; i < configs.size(); i++) {
+        if (configs[i].minSignalSize <= configs[i].maxSignalSize) valid.push_back(configs[i]);
+    }
+
+    int threads = atoi(cmd_line.get_arg("-threads").c_str());
+    if (threads <= 0) {
+        threads = std::max((int)std::thread::hardware_concurrency(), 1);
+    }
+    double truthBpm = atof(cmd_line.get_arg("-bpm").c_str());
+
+    ParameterSweep parameterSweep;
+    if (!parameterSweep.load(replayPath)) {
+        std::cout << "Please specify valid trace!" << std::endl;
+        exit(0);
+    }
+
+    cout << "Sweeping " << valid.size() << " configurations over " << replayPath << " on " << threads << " threads" << endl;
+
+    const int64 start = cv::getTickCount();
+    vector<SweepResult> results;
+    parameterSweep.run(valid, threads, truthBpm, results);
+
+    if (!ParameterSweep::write(output, valid, results)) {
+        std::cout << "Could not write " << output << std::endl;
+        return -1;
+    }
+
+    cout << "Swept " << valid.size() << " configurations in " << (cv::getTickCount() - start) / cv::getTickFrequency() << " s, results in " << output << endl;
+
+    return 0;
+}
+
+// Age in seconds of the last frame grabbed from a camera at tick now, or -1
+// when the backend does not stamp its buffers on the monotonic tick clock
+double captureAge(VideoCapture &cap, int64 now) {
+    const double captured = cap.get(CAP_PROP_POS_MSEC);
+    const double age = now / cv::getTickFrequency() - captured / 1000;
+    return captured > 0 && age >= 0 && age <= MAX_CAPTURE_AGE ? age : -1;
+}
+
 int main(int argc, char * argv[]) {
 
     Heartbeat cmd_line(argc, argv, true);
 
+    // Parameter sweep over a recorded trace
+    string sweepPath = cmd_line.get_arg("-sweep");
+    if (sweepPath != "") {
+        return sweep(cmd_line, sweepPath);
+    }
+
     string input = cmd_line.get_arg("-i"); // Filepath for offline mode
 
     // algorithm setting
@@ -134,6 +311,33 @@ int main(int argc, char * argv[]) {
 
     cout << "Using face detection algorithm " << faceDetAlg << "." << endl;
 
+    // bandpass algorithm setting
+    bandpassAlgorithm bandpassAlg;
+    string bandpassAlgString = cmd_line.get_arg("-filter");
+    if (bandpassAlgString != "") {
+        bandpassAlg = to_bandpassAlgorithm(bandpassAlgString);
+    } else {
+        bandpassAlg = to_bandpassAlgorithm(DEFAULT_BANDPASS_ALGORITHM);
+    }
+
+    // pca algorithm setting
+    pcaAlgorithm pcaAlg;
+    string pcaAlgString = cmd_line.get_arg("-pca");
+    if (pcaAlgString != "") {
+        pcaAlg = to_pcaAlgorithm(pcaAlgString);
+    } else {
+        pcaAlg = to_pcaAlgorithm(DEFAULT_PCA_ALGORITHM);
+    }
+
+    // estimator algorithm setting
+    estimatorAlgorithm estimatorAlg;
+    string estimatorAlgString = cmd_line.get_arg("-estimator");
+    if (estimatorAlgString != "") {
+        estimatorAlg = to_estimatorAlgorithm(estimatorAlgString);
+    } else {
+        estimatorAlg = to_estimatorAlgorithm(DEFAULT_ESTIMATOR_ALGORITHM);
+    }
+
     // rescanFrequency setting
     double rescanFrequency;
     string rescanFrequencyString = cmd_line.get_arg("-r");
@@ -152,6 +356,24 @@ int main(int argc, char * argv[]) {
         samplingFrequency = DEFAULT_SAMPLING_FREQUENCY;
     }
 
+    // estimation hop setting
+    double estimationHop;
+    string estimationHopString = cmd_line.get_arg("-hop");
+    if (estimationHopString != "") {
+        estimationHop = atof(estimationHopString.c_str());
+    } else {
+        estimationHop = DEFAULT_ESTIMATION_HOP;
+    }
+
+    // resampling setting
+    double resampleRate;
+    string resampleRateString = cmd_line.get_arg("-resample");
+    if (resampleRateString != "") {
+        resampleRate = atof(resampleRateString.c_str());
+    } else {
+        resampleRate = DEFAULT_RESAMPLE_RATE;
+    }
+
     // max signal size setting
     int maxSignalSize;
     string maxSignalSizeString = cmd_line.get_arg("-max");
@@ -193,6 +415,33 @@ int main(int argc, char * argv[]) {
         log = false;
     }
 
+    // Reading quality gating setting
+    bool quality;
+    string qualityString = cmd_line.get_arg("-quality");
+    if (qualityString != "") {
+        quality = to_bool(qualityString);
+    } else {
+        quality = false;
+    }
+
+    // Reading peak interpolation setting
+    bool interpolate;
+    string interpolateString = cmd_line.get_arg("-interpolate");
+    if (interpolateString != "") {
+        interpolate = to_bool(interpolateString);
+    } else {
+        interpolate = true;
+    }
+
+    // Reading patch grid setting
+    Size patchGrid;
+    string patchGridString = cmd_line.get_arg("-patches");
+    if (patchGridString != "") {
+        patchGrid = to_patchGrid(patchGridString);
+    } else {
+        patchGrid = Size(1, 1);
+    }
+
     // Reading downsample setting
     int downsample;
     string downsampleString = cmd_line.get_arg("-ds");
@@ -220,22 +469,154 @@ int main(int argc, char * argv[]) {
         exit(0);
     }
 
+    // Pipeline settings; the input sets the frame size, time base and log path
+    RPPGSettings settings;
+    settings.rPPGAlg = rPPGAlg;
+    settings.faceDetAlg = faceDetAlg;
+    settings.bandpassAlg = bandpassAlg;
+    settings.pcaAlg = pcaAlg;
+    settings.estimatorAlg = estimatorAlg;
+    settings.downsample = downsample;
+    settings.samplingFrequency = samplingFrequency;
+    settings.rescanFrequency = rescanFrequency;
+    settings.minSignalSize = minSignalSize;
+    settings.maxSignalSize = maxSignalSize;
+    settings.estimationHop = estimationHop;
+    settings.resampleRate = resampleRate;
+    settings.quality = quality;
+    settings.interpolate = interpolate;
+    settings.patchGrid = patchGrid;
+    settings.haarPath = HAAR_CLASSIFIER_PATH;
+    settings.dnnProtoPath = DNN_PROTO_PATH;
+    settings.dnnModelPath = DNN_MODEL_PATH;
+    settings.log = log;
+
+    // Batch processing of a directory or manifest
+    string batchSource = cmd_line.get_arg("-batch");
+    if (batchSource != "") {
+
+        BatchRunner batch;
+        if (!batch.load(batchSource)) {
+            std::cout << "Please specify valid batch directory or manifest!" << std::endl;
+            exit(0);
+        }
+
+        int threads = atoi(cmd_line.get_arg("-threads").c_str());
+        if (threads <= 0) {
+            threads = std::max((int)std::thread::hardware_concurrency(), 1);
+        }
+        const string forceString = cmd_line.get_arg("-force");
+        const bool force = forceString != "" && to_bool(forceString);
+        string summaryPath = cmd_line.get_arg("-summary");
+        if (summaryPath == "") {
+            summaryPath = DEFAULT_BATCH_SUMMARY;
+        }
+
+        cout << "Processing " << batch.size() << " recordings from " << batchSource << " on " << threads << " threads" << endl;
+
+        const int64 start = cv::getTickCount();
+        vector<BatchResult> results;
+        batch.run(settings, threads, force, results);
+
+        if (!BatchRunner::write(summaryPath, results)) {
+            std::cout << "Could not write " << summaryPath << std::endl;
+            return -1;
+        }
+
+        cout << "Processed " << batch.size() << " recordings in " << (cv::getTickCount() - start) / cv::getTickFrequency() << " s, summary in " << summaryPath << endl;
+
+        return 0;
+    }
+
+    // Trace settings
+    string tracePath = cmd_line.get_arg("-trace");
+    string replayPath = cmd_line.get_arg("-replay");
+
+    // Result ring for consumers on this host
+    string ringName = cmd_line.get_arg("-ring");
+    const int stream = atoi(cmd_line.get_arg("-stream").c_str());
+    RingPublisher publisher;
+    if (ringName != "" && !publisher.open(ringName)) {
+        std::cout << "Could not create ring " << ringName << std::endl;
+        exit(0);
+    }
+
+    if (replayPath != "") {
+
+        TraceReader trace;
+        if (!trace.open(replayPath)) {
+            std::cout << "Please specify valid trace!" << std::endl;
+            exit(0);
+        }
+
+        cout << "Replaying " << replayPath << endl;
+
+        // Set up rPPG without video or face detector; traces hold the combined patch samples
+        settings.timeBase = trace.getTimeBase();
+        settings.patchGrid = Size(1, 1);
+        settings.haarPath = "";
+        settings.dnnProtoPath = "";
+        settings.dnnModelPath = "";
+        settings.logPath = replayPath.substr(0, replayPath.find_last_of("."));
+        RPPG rppg = RPPG();
+        rppg.load(settings);
+        rppg.setPublisher(publisher.isOpen() ? &publisher : nullptr, stream);
+
+        const int64 start = cv::getTickCount();
+        int i = 0;
+        TraceSample sample;
+
+        // The trace holds only the frames that were processed, so -ds was
+        // applied when it was recorded
+        while (trace.read(sample)) {
+            rppg.processTrace(sample);
+            i++;
+        }
+
+        const double seconds = (cv::getTickCount() - start) / cv::getTickFrequency();
+        cout << "Replayed " << i << " samples in " << seconds << " s (" << i / seconds << " samples/s)" << endl;
+
+        rppg.exit();
+        return 0;
+    }
+
+    // Raw frames from stdin or a pipe are processed like a file, the writer
+    // blocks while we are behind
+    string rawString = cmd_line.get_arg("-raw");
+    const bool rawMode = rawString != "";
+    if (rawMode && input == "") {
+        input = "-";
+    }
+
     bool offlineMode = input != "";
 
     VideoCapture cap;
-    if (offlineMode) cap.open(input);
-    else cap.open(0);
-    if (!cap.isOpened()) {
-        return -1;
+    RawVideo raw;
+    if (rawMode) {
+        const int rawWidth = atoi(cmd_line.get_arg("-width").c_str());
+        const int rawHeight = atoi(cmd_line.get_arg("-height").c_str());
+        const double rawFps = atof(cmd_line.get_arg("-fps").c_str());
+        if (!raw.open(input, to_rawFormat(rawString), rawWidth, rawHeight, rawFps, cmd_line.get_arg("-timestamps"))) {
+            std::cout << "Please specify valid raw input with -width, -height and -fps!" << std::endl;
+            exit(0);
+        }
+    } else {
+        if (offlineMode) cap.open(input);
+        else cap.open(0);
+        if (!cap.isOpened()) {
+            return -1;
+        }
     }
 
     std::string title = offlineMode ? "rPPG offline" : "rPPG online";
     cout << title << endl;
-    cout << "Processing " << (offlineMode ? input : "live feed") << endl;
+    cout << "Processing " << (offlineMode ? (input == "-" ? "stdin" : input) : "live feed") << endl;
 
     // Configure logfile path
     string LOG_PATH;
-    if (offlineMode) {
+    if (input == "-") {
+        LOG_PATH = "Raw_stdin";
+    } else if (offlineMode) {
         LOG_PATH = input.substr(0, input.find_last_of("."));
     } else {
         std::ostringstream filepath;
@@ -244,9 +625,9 @@ int main(int argc, char * argv[]) {
     }
 
     // Load video information
-    const int WIDTH = cap.get(cv::CAP_PROP_FRAME_WIDTH);
-    const int HEIGHT = cap.get(cv::CAP_PROP_FRAME_HEIGHT);
-    const double FPS = cap.get(cv::CAP_PROP_FPS);
+    const int WIDTH = rawMode ? raw.getWidth() : cap.get(cv::CAP_PROP_FRAME_WIDTH);
+    const int HEIGHT = rawMode ? raw.getHeight() : cap.get(cv::CAP_PROP_FRAME_HEIGHT);
+    const double FPS = rawMode ? raw.getFps() : cap.get(cv::CAP_PROP_FPS);
     const double TIME_BASE = 0.001;
 
     // Print video information
@@ -258,49 +639,122 @@ int main(int argc, char * argv[]) {
     window_title << title << " - " << WIDTH << "x" << HEIGHT << " -rppg " << rPPGAlg << " -facedet " << faceDetAlg << " -r " << rescanFrequency << " -f " << samplingFrequency << " -min " << minSignalSize << " -max " << maxSignalSize << " -ds " << downsample;
 
     // Set up rPPG
+    settings.width = WIDTH;
+    settings.height = HEIGHT;
+    settings.timeBase = TIME_BASE;
+    settings.logPath = LOG_PATH;
+    settings.tracePath = tracePath;
+    settings.gui = gui;
     RPPG rppg = RPPG();
-    rppg.load(rPPGAlg, faceDetAlg,
-              WIDTH, HEIGHT, TIME_BASE, downsample,
-              samplingFrequency, rescanFrequency,
-              minSignalSize, maxSignalSize,
-              LOG_PATH, HAAR_CLASSIFIER_PATH,
-              DNN_PROTO_PATH, DNN_MODEL_PATH,
-              log, gui);
+    rppg.load(settings);
+    rppg.setPublisher(publisher.isOpen() ? &publisher : nullptr, stream);
 
     cout << "START ALGORITHM" << endl;
 
+    // Shed work when the live stream falls behind capture
+    RealtimeScheduler scheduler;
+    scheduler.load(1.0 / (FPS > 0 ? FPS : DEFAULT_LIVE_FPS));
+
+    // Per-frame latency tracing
+    string latencyPath = cmd_line.get_arg("-latency");
+    LatencyTracer tracer;
+    if (latencyPath != "") {
+        rppg.setTracer(&tracer);
+    }
+
     int i = 0;
     Mat frameRGB, frameGray;
 
     while (true) {
 
+        const int64 waitStart = cv::getTickCount();
+
+        // Far behind: drain the queued frame without decoding it
+        if (!offlineMode && scheduler.dropFrame()) {
+            if (!cap.grab()) break;
+            const int64 grabbed = cv::getTickCount();
+            scheduler.update((grabbed - waitStart) / cv::getTickFrequency(), 0, captureAge(cap, grabbed));
+            cout << "DROPPING FRAME, LAG " << scheduler.getLag() << " s" << endl;
+            i++;
+            continue;
+        }
+
         // Grab RGB frame
-        cap.read(frameRGB);
+        int64_t rawTime = 0;
+        if (rawMode) {
+            if (!raw.read(frameRGB, rawTime)) break;
+        } else {
+            cap.read(frameRGB);
+        }
 
         if (frameRGB.empty())
             break;
 
+        const int64 workStart = cv::getTickCount();
+
+        // Live frames were captured before they were read, by their measured
+        // age or else by the modeled lag
+        const double age = offlineMode ? 0 : captureAge(cap, workStart);
+        const double behind = age >= 0 ? age : scheduler.getLag();
+        const int64 captureTicks = workStart - (int64)(behind * cv::getTickFrequency());
+
+        if (latencyPath != "") {
+            tracer.beginFrame(i, captureTicks);
+            tracer.span("read", waitStart, workStart);
+        }
+
         // Generate grayframe
         cvtColor(frameRGB, frameGray, COLOR_BGR2GRAY);
         equalizeHist(frameGray, frameGray);
 
-        int time;
-        if (offlineMode) time = (int)cap.get(CAP_PROP_POS_MSEC);
-        else time = (cv::getTickCount()*1000.0)/cv::getTickFrequency();
+        if (latencyPath != "") {
+            tracer.span("preprocess", workStart, cv::getTickCount());
+        }
+
+        int64_t time;
+        if (rawMode) time = rawTime;
+        else if (offlineMode) time = (int64_t)cap.get(CAP_PROP_POS_MSEC);
+        else time = (int64_t)((captureTicks*1000.0)/cv::getTickFrequency());
+
+        if (!offlineMode) {
+            rppg.setLoad(scheduler.getLevel(), behind);
+        }
 
         if (i % downsample == 0) {
             rppg.processFrame(frameRGB, frameGray, time);
+            if (latencyPath != "") {
+                tracer.endFrame(cv::getTickCount());
+            }
         } else {
             cout << "SKIPPING FRAME TO DOWNSAMPLE!" << endl;
         }
 
+        // Drawing follows the result and is traced outside its latency
         if (gui) {
+            const int64 displayStart = cv::getTickCount();
             imshow(window_title.str(), frameRGB);
-            if (waitKey(30) >= 0) break;
+            const int key = waitKey(scheduler.getLevel() >= skipDrawing ? 1 : 30);
+            if (latencyPath != "") {
+                tracer.span("display", displayStart, cv::getTickCount());
+            }
+            if (key >= 0) break;
+        }
+
+        if (!offlineMode) {
+            const int64 workEnd = cv::getTickCount();
+            scheduler.update((workStart - waitStart) / cv::getTickFrequency(),
+                             (workEnd - workStart) / cv::getTickFrequency(), age);
         }
 
         i++;
     }
 
+    if (latencyPath != "") {
+        tracer.report(cout);
+        if (!tracer.write(latencyPath)) {
+            cout << "Could not write " << latencyPath << endl;
+        }
+    }
+
     return 0;
 }
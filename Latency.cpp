@@ -0,0 +1,139 @@
+//
+//  Latency.cpp
+//  Heartbeat
+//
+//  Created by Philipp Rouast on 19/10/2026.
+//  Copyright © 2026 Philipp Roüast. All rights reserved.
+//
+
+#include "Latency.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+#define MAX_TRACE_SPANS 1000000 // spans kept for the dump, durations are always counted
+#define LATENCY_STAGE "capture_to_result"
+#define LATENCY_MIN_MS 0.001 // lower edge of the histogram, shorter spans share the first bucket
+#define BUCKETS_PER_OCTAVE 16 // about 4% wide, percentiles are reported at bucket centers
+#define LATENCY_BUCKETS 432 // 27 octaves, up to about two minutes
+
+using namespace cv;
+using namespace std;
+
+static double milliseconds(int64 ticks) {
+    return ticks * 1000.0 / getTickFrequency();
+}
+
+void LatencyTracer::beginFrame(int frame, int64 capture) {
+    if (origin == 0) {
+        origin = capture;
+    }
+    this->frame = frame;
+    this->capture = capture;
+}
+
+int LatencyTracer::intern(const char *name) {
+
+    // Callers pass literals, so the pointer almost always matches
+    for (size_t i = 0; i < stages.size(); i++) {
+        if (stages[i].name == name) return (int)i;
+    }
+    for (size_t i = 0; i < stages.size(); i++) {
+        if (strcmp(stages[i].name, name) == 0) return (int)i;
+    }
+
+    Stage stage;
+    stage.name = name;
+    stage.counts.assign(LATENCY_BUCKETS, 0);
+    stage.total = 0;
+    stage.max = 0;
+    stages.push_back(stage);
+    return (int)stages.size() - 1;
+}
+
+void LatencyTracer::span(const char *name, int64 start, int64 end) {
+
+    const int index = intern(name);
+    Stage &stage = stages[index];
+
+    const double ms = milliseconds(end - start);
+    const int bucket = ms > LATENCY_MIN_MS ? (int)(log2(ms / LATENCY_MIN_MS) * BUCKETS_PER_OCTAVE) : 0;
+    stage.counts[min(bucket, LATENCY_BUCKETS - 1)]++;
+    stage.total++;
+    stage.max = max(stage.max, ms);
+
+    if (spans.size() < MAX_TRACE_SPANS) {
+        Span s = {index, frame, start, end};
+        spans.push_back(s);
+    }
+}
+
+void LatencyTracer::endFrame(int64 emitted) {
+    if (resultStage < 0) {
+        resultStage = intern(LATENCY_STAGE);
+    }
+    span(stages[resultStage].name, capture, emitted);
+}
+
+double LatencyTracer::percentile(const Stage &stage, double fraction) const {
+
+    // Same rank as indexing the sorted durations at fraction * count
+    const long rank = min((long)(stage.total * fraction) + 1, stage.total);
+
+    long seen = 0;
+    int bucket = 0;
+    while (bucket < LATENCY_BUCKETS - 1 && (seen += stage.counts[bucket]) < rank) {
+        bucket++;
+    }
+    return min(LATENCY_MIN_MS * exp2((bucket + 0.5) / BUCKETS_PER_OCTAVE), stage.max);
+}
+
+void LatencyTracer::report(ostream &out) const {
+
+    out << "Latency (ms)      count      p50      p90      p99      max" << endl;
+
+    // Stages in name order
+    vector<const Stage *> sorted;
+    for (size_t i = 0; i < stages.size(); i++) {
+        sorted.push_back(&stages[i]);
+    }
+    sort(sorted.begin(), sorted.end(), [](const Stage *a, const Stage *b) {
+        return strcmp(a->name, b->name) < 0;
+    });
+
+    for (size_t i = 0; i < sorted.size(); i++) {
+        const Stage &stage = *sorted[i];
+        char row[128];
+        snprintf(row, sizeof(row), "%-17s %6ld %8.2f %8.2f %8.2f %8.2f", stage.name, stage.total,
+                 percentile(stage, 0.5), percentile(stage, 0.9), percentile(stage, 0.99), stage.max);
+        out << row << endl;
+    }
+}
+
+bool LatencyTracer::write(const string &path) const {
+
+    ofstream json(path.c_str());
+    if (!json.is_open()) {
+        return false;
+    }
+
+    // Complete events in microseconds since the first capture; the end-to-end
+    // span goes on its own row so it does not hide the stages
+    json << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n"
+         << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 1, \"args\": {\"name\": \"stages\"}},\n"
+         << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 2, \"args\": {\"name\": \"" LATENCY_STAGE "\"}}";
+    for (size_t i = 0; i < spans.size(); i++) {
+        const Span &s = spans[i];
+        const bool endToEnd = s.stage == resultStage;
+        json << ",\n"
+             << "{\"name\": \"" << stages[s.stage].name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << (endToEnd ? 2 : 1)
+             << ", \"ts\": " << (int64)(1000 * milliseconds(s.start - origin))
+             << ", \"dur\": " << (int64)(1000 * milliseconds(s.end - s.start))
+             << ", \"args\": {\"frame\": " << s.frame << "}}";
+    }
+    json << "\n]}\n";
+
+    return json.good();
+}
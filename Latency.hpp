@@ -0,0 +1,84 @@
+//
+//  Latency.hpp
+//  Heartbeat
+//
+//  Created by Philipp Rouast on 19/10/2026.
+//  Copyright © 2026 Philipp Roüast. All rights reserved.
+//
+
+#ifndef Latency_hpp
+#define Latency_hpp
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include <stdio.h>
+
+/* LATENCY TRACING
+ *
+ * Per-frame spans from capture to result emission. Every frame records
+ * when it was captured, the span of each stage it passed through and when
+ * its result was emitted; the spans are kept for a Chrome trace-event dump
+ * and their durations go into a fixed log-scale histogram per stage for
+ * latency percentiles. Stages are interned by name on their first span, so
+ * recording a span neither builds strings nor allocates once every stage
+ * has been seen. */
+
+class LatencyTracer {
+
+public:
+
+    LatencyTracer() {;}
+
+    // Start a frame captured at the given tick count
+    void beginFrame(int frame, int64 capture);
+
+    // Stage of the current frame between two tick counts; name must outlive the tracer
+    void span(const char *name, int64 start, int64 end);
+
+    // Result of the current frame emitted at the given tick count. Spans
+    // recorded after it, like drawing the frame, still belong to the frame
+    // but lie outside its capture-to-result latency
+    void endFrame(int64 emitted);
+
+    // Percentiles of the stage and capture-to-result latencies
+    void report(std::ostream &out) const;
+
+    // Chrome trace-event JSON, viewable in chrome://tracing or Perfetto
+    bool write(const std::string &path) const;
+
+private:
+
+    struct Span {
+        int stage;
+        int frame;
+        int64 start;
+        int64 end;
+    };
+
+    // Durations of a stage, counted in log-spaced buckets
+    struct Stage {
+        const char *name;
+        std::vector<long> counts;
+        long total;
+        double max;  // ms
+    };
+
+    // Index of the stage with this name, added on first use
+    int intern(const char *name);
+
+    // Duration in ms below which the given fraction of a stage's spans fall
+    double percentile(const Stage &stage, double fraction) const;
+
+    std::vector<Span> spans;
+    std::vector<Stage> stages;
+    int resultStage = -1;
+    int frame = 0;
+    int64 capture = 0;
+    int64 origin = 0;
+};
+
+#endif /* Latency_hpp */
@@ -0,0 +1,89 @@
+//
+//  Monitor.cpp
+//  Heartbeat
+//
+//  Created by Philipp Rouast on 19/10/2026.
+//  Copyright © 2026 Philipp Roüast. All rights reserved.
+//
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "Ring.hpp"
+
+#define DEFAULT_RING_NAME "heartbeat"
+#define DEFAULT_POLL 100 // microseconds
+#define ATTACH_POLL 100 // milliseconds between attempts while the ring does not exist
+
+using namespace std;
+
+static string getArg(int argc, char * argv[], const string &name, const string &fallback) {
+    for (int i = 1; i < argc - 1; i++) {
+        if (name == argv[i]) {
+            return argv[i + 1];
+        }
+    }
+    return fallback;
+}
+
+int main(int argc, char * argv[]) {
+
+    const string name = getArg(argc, argv, "-ring", DEFAULT_RING_NAME);
+    const string oldest = getArg(argc, argv, "-oldest", "false");
+    const int poll = atoi(getArg(argc, argv, "-poll", to_string(DEFAULT_POLL)).c_str());
+
+    if (oldest != "true" && oldest != "false") {
+        cerr << "Please specify valid -oldest (" << oldest << ")!" << endl;
+        exit(0);
+    }
+
+    if (poll < 0) {
+        cerr << "Please specify valid -poll (" << poll << ")!" << endl;
+        exit(0);
+    }
+
+    // Wait for the engine to create the ring
+    RingReader reader;
+    bool waiting = false;
+    while (!reader.open(name, oldest == "true")) {
+        if (!waiting) {
+            cerr << "Waiting for ring " << name << "..." << endl;
+            waiting = true;
+        }
+        this_thread::sleep_for(chrono::milliseconds(ATTACH_POLL));
+    }
+
+    cout << "time;stream;face;face_valid;bpm;mean;min;max;snr;motion;saturation;accepted;x;y;width;height" << endl;
+
+    RingRecord r;
+    uint64_t dropped = 0;
+
+    while (true) {
+
+        if (!reader.read(r)) {
+
+            // Records published before the close are visible once it is
+            const bool closed = reader.isClosed();
+            if (!reader.read(r)) {
+                if (closed) break;
+                if (poll > 0) this_thread::sleep_for(chrono::microseconds(poll));
+                continue;
+            }
+        }
+
+        if (reader.getDropped() > dropped) {
+            cerr << "Dropped " << reader.getDropped() - dropped << " records" << endl;
+            dropped = reader.getDropped();
+        }
+
+        cout << r.time << ";" << r.stream << ";" << r.face << ";" << r.faceValid << ";"
+             << r.bpm << ";" << r.meanBpm << ";" << r.minBpm << ";" << r.maxBpm << ";"
+             << r.snr << ";" << r.motion << ";" << r.saturation << ";" << r.accepted << ";"
+             << r.x << ";" << r.y << ";" << r.width << ";" << r.height << endl;
+    }
+
+    return 0;
+}
@@ -12,8 +12,10 @@
 #include <opencv2/highgui.hpp>
 #include <opencv2/core.hpp>
 #include <opencv2/video.hpp>
+#include <limits>
 
 #include "opencv.hpp"
+#include "dsp.hpp"
 
 using namespace cv;
 using namespace dnn;
@@ -27,70 +29,157 @@ using namespace std;
 #define MIN_CORNERS 5
 #define QUALITY_LEVEL 0.01
 #define MIN_DISTANCE 25
-
-bool RPPG::load(const rPPGAlgorithm rPPGAlg, const faceDetAlgorithm faceDetAlg,
-                const int width, const int height, const double timeBase, const int downsample,
-                const double samplingFrequency, const double rescanFrequency,
-                const int minSignalSize, const int maxSignalSize,
-                const string &logPath, const string &haarPath,
-                const string &dnnProtoPath, const string &dnnModelPath,
-                const bool log, const bool gui) {
-
-    this->rPPGAlg = rPPGAlg;
-    this->faceDetAlg = faceDetAlg;
-    this->guiMode = gui;
+#define IIR_ORDER 4
+#define IIR_FPS_TOLERANCE 0.1
+#define PCA_MAX_ANGLE 0.1
+#define WELCH_MIN_SEGMENT_SIZE 8
+#define PULSE_WINDOW_SIZE 1.6 // seconds
+#define WORKSPACE_MAX_FPS 60 // expected frame rate bound; larger windows grow the buffers once
+#define MAX_MOTION 0.02 // mean face displacement per frame, relative to face width
+#define MAX_SATURATION 0.2 // fraction of saturated samples in the window
+#define SATURATION_SIGMA 2
+#define DARK_LEVEL 20
+#define MIN_SNR -3 // dB
+#define MAX_SNR 30 // dB, caps the weight of a single estimate
+#define DEGRADED_ESTIMATION_HOP 1 // seconds, minimum hop from lengthenHop
+#define DEGRADED_RESCAN_FACTOR 4 // rescan interval multiplier from deferRescan
+#define PATCH_LEFT 0.2 // face region of the patch grid, relative to the box
+#define PATCH_RIGHT 0.8
+#define PATCH_TOP 0.1
+#define PATCH_BOTTOM 0.8
+#define EYES_TOP 0.3 // band left out of the patch grid, relative to the box
+#define EYES_BOTTOM 0.5
+
+bool RPPG::load(const RPPGSettings &settings) {
+
+    this->rPPGAlg = settings.rPPGAlg;
+    this->bandpassAlg = settings.bandpassAlg;
+    this->pcaAlg = settings.pcaAlg;
+    this->faceDetAlg = settings.faceDetAlg;
+    this->guiMode = settings.gui;
     this->lastSamplingTime = 0;
-    this->logMode = log;
-    this->minFaceSize = Size(min(width, height) * REL_MIN_FACE_SIZE, min(width, height) * REL_MIN_FACE_SIZE);
-    this->maxSignalSize = maxSignalSize;
-    this->minSignalSize = minSignalSize;
+    this->logMode = settings.log;
+    this->qualityMode = settings.quality;
+    this->interpolateMode = settings.interpolate;
+    this->patchGrid = Size(max(settings.patchGrid.width, 1), max(settings.patchGrid.height, 1));
+    this->degradation = nominal;
+    this->lag = 0;
+    this->minFaceSize = Size(min(settings.width, settings.height) * REL_MIN_FACE_SIZE, min(settings.width, settings.height) * REL_MIN_FACE_SIZE);
+    this->maxSignalSize = settings.maxSignalSize;
+    this->minSignalSize = settings.minSignalSize;
     this->rescanFlag = false;
-    this->rescanFrequency = rescanFrequency;
-    this->samplingFrequency = samplingFrequency;
-    this->timeBase = timeBase;
-
-    // Load classifier
+    this->rescanFrequency = settings.rescanFrequency;
+    this->samplingFrequency = settings.samplingFrequency;
+    this->estimationHop = settings.estimationHop;
+    this->resampleRate = settings.resampleRate;
+    this->estimatorAlg = settings.estimatorAlg;
+    this->extractor = selectExtractor();
+    this->sampleUpdater = selectSampleUpdater();
+    this->sampleCount = 0;
+    this->motionSum = 0;
+    this->saturatedCount = 0;
+    this->snr = numeric_limits<double>::quiet_NaN();
+    this->motion = 0;
+    this->saturation = 0;
+    this->accepted = false;
+    this->resampleSize = 0;
+    if (resampleRate > 0) {
+        // Largest window within maxSignalSize that the DFT handles without padding
+        resampleSize = max((int)(resampleRate * maxSignalSize), 1);
+        while (resampleSize > 1 && getOptimalDFTSize(resampleSize) != resampleSize) {
+            resampleSize--;
+        }
+        cout << "Resampling to " << resampleRate << " Hz, window of " << resampleSize << " samples." << endl;
+    }
+    this->lastEstimationTime = 0;
+    this->timeBase = settings.timeBase;
+    this->meanBpm = 0;
+    this->minBpm = 0;
+    this->maxBpm = 0;
+    this->stageTimes = StageTimes();
+    this->bpms = Mat1d();
+    this->bpmWeights = Mat1d();
+
+    // Size the buffers, the workspace and the transform scratch for the largest window
+    this->windowCapacity = resampleRate > 0 ? resampleSize : (int)(WORKSPACE_MAX_FPS * maxSignalSize) + 1;
+    workspace.reserve(windowCapacity);
+    reserveTransforms(windowCapacity);
+
+    // Start from empty buffers, the object may be reused across videos
+    invalidateFace();
+
+    // Load classifier, kept across loads
     switch (faceDetAlg) {
       case haar:
-        haarClassifier.load(haarPath);
+        if (haarClassifier.empty() && settings.haarPath != "") haarClassifier.load(settings.haarPath);
         break;
       case deep:
-        dnnClassifier = readNetFromCaffe(dnnProtoPath, dnnModelPath);
+        if (dnnClassifier.empty() && settings.dnnProtoPath != "") dnnClassifier = readNetFromCaffe(settings.dnnProtoPath, settings.dnnModelPath);
         break;
     }
 
-    // Setting up logfilepath
-    ostringstream path_1;
-    path_1 << logPath << "_rppg=" << rPPGAlg << "_facedet=" << faceDetAlg << "_min=" << minSignalSize << "_max=" << maxSignalSize << "_ds=" << downsample;
-    this->logfilepath = path_1.str();
+    cout << "Using " << dsp::isaName() << " DSP kernels." << endl;
 
-    // Logging bpm according to sampling frequency
-    std::ostringstream path_2;
-    path_2 << logfilepath << "_bpm.csv";
-    logfile.open(path_2.str());
-    logfile << "time;face_valid;mean;min;max\n";
-    logfile.flush();
+    // Log files, none without a log path
+    if (!settings.logPath.empty()) {
 
-    // Logging bpm detailed
-    std::ostringstream path_3;
-    path_3 << logfilepath << "_bpmAll.csv";
-    logfileDetailed.open(path_3.str());
-    logfileDetailed << "time;face_valid;bpm\n";
-    logfileDetailed.flush();
+        // Setting up logfilepath
+        this->logfilepath = logfilePath(settings);
+
+        // Logging bpm according to sampling frequency
+        std::ostringstream path_2;
+        path_2 << logfilepath << "_bpm.csv";
+        logfile.open(path_2.str());
+        logfile << "time;face_valid;mean;min;max;lag;degradation\n";
+        logfile.flush();
+
+        // Logging bpm detailed
+        std::ostringstream path_3;
+        path_3 << logfilepath << "_bpmAll.csv";
+        logfileDetailed.open(path_3.str());
+        logfileDetailed << "time;face_valid;bpm;snr;motion;saturation;accepted;lag;degradation\n";
+        logfileDetailed.flush();
+    }
+
+    // Recording the raw samples
+    if (!settings.tracePath.empty() && !traceWriter.open(settings.tracePath, timeBase)) {
+        cout << "Could not open trace " << settings.tracePath << endl;
+        return false;
+    }
 
     return true;
 }
 
+string RPPG::logfilePath(const RPPGSettings &settings) {
+    ostringstream path;
+    path << settings.logPath << "_rppg=" << settings.rPPGAlg << "_facedet=" << settings.faceDetAlg
+         << "_min=" << settings.minSignalSize << "_max=" << settings.maxSignalSize << "_ds=" << settings.downsample;
+    return path.str();
+}
+
+void RPPG::setSharedWindow(SharedWindow *shared) {
+    this->sharedWindow = shared;
+    this->extractor = selectExtractor();
+}
+
 void RPPG::exit() {
     logfile.close();
     logfileDetailed.close();
+    traceWriter.close();
 }
 
-void RPPG::processFrame(Mat &frameRGB, Mat &frameGray, int time) {
+void RPPG::processFrame(Mat &frameRGB, Mat &frameGray, int64_t time) {
 
     // Set time
     this->time = time;
 
+    // Motion is only measured while tracking
+    frameMotion = 0;
+
+    const int64 start = getTickCount();
+    int64 tick = start;
+    const char *faceStage = "detect";
+
     if (!faceValid) {
 
         cout << "Not valid, finding a new face" << endl;
@@ -98,7 +187,7 @@ void RPPG::processFrame(Mat &frameRGB, Mat &frameGray, int time) {
         lastScanTime = time;
         detectFace(frameRGB, frameGray);
 
-    } else if ((time - lastScanTime) * timeBase >= 1/rescanFrequency) {
+    } else if ((time - lastScanTime) * timeBase >= (degradation >= deferRescan ? DEGRADED_RESCAN_FACTOR : 1) / rescanFrequency) {
 
         cout << "Valid, but rescanning face" << endl;
 
@@ -110,71 +199,275 @@ void RPPG::processFrame(Mat &frameRGB, Mat &frameGray, int time) {
 
         cout << "Tracking face" << endl;
 
+        faceStage = "track";
         trackFace(frameGray);
     }
 
-    if (faceValid) {
-
-        // Update fps
-        fps = getFps(t, timeBase);
+    endStage(stageTimes.face, faceStage, tick);
 
-        // Remove old values from raw signal buffer
-        while (s.rows > fps * maxSignalSize) {
-            push(s);
-            push(t);
-            push(re);
-        }
+    if (faceValid) {
 
-        assert(s.rows == t.rows && s.rows == re.rows);
+        tick = getTickCount();
 
         // New values
-        Scalar means = mean(frameRGB, mask);
-        // Add new values to raw signal buffer
-        double values[] = {means(0), means(1), means(2)};
-        s.push_back(Mat(1, 3, CV_64F, values));
-        t.push_back(time);
-
-        // Save rescan flag
-        re.push_back(rescanFlag);
-
-        // Update fps
-        fps = getFps(t, timeBase);
-
-        // Update band spectrum limits
-        low = (int)(s.rows * LOW_BPM / SEC_PER_MIN / fps);
-        high = (int)(s.rows * HIGH_BPM / SEC_PER_MIN / fps) + 1;
-
-        // If valid signal is large enough: estimate
-        if (s.rows >= fps * minSignalSize) {
-
-            // Filtering
-            switch (rPPGAlg) {
-                case g:
-                    extractSignal_g();
-                    break;
-                case pca:
-                    extractSignal_pca();
-                    break;
-                case xminay:
-                    extractSignal_xminay();
-                    break;
+        float values[3];
+        if (patchGrid.area() > 1) {
+            samplePatches(frameRGB, values);
+        } else {
+            Scalar means, stddevs;
+            meanStdDev(frameRGB, means, stddevs, mask);
+            for (int c = 0; c < 3; c++) {
+                values[c] = (float)means(c);
             }
 
-            // HR estimation
-            estimateHeartrate();
-
-            // Log
-            log();
+            // ROI is unusable if a channel is largely clipped or too dark
+            frameSaturated = false;
+            for (int c = 0; c < 3; c++) {
+                frameSaturated = frameSaturated || means(c) + SATURATION_SIGMA * stddevs(c) >= 255 || means(c) <= DARK_LEVEL;
+            }
         }
 
-        if (guiMode) {
+        endStage(stageTimes.sample, "roi", tick);
+
+        writeTrace(values);
+
+        updateSignal(values);
+
+        if (guiMode && degradation < skipDrawing) {
             draw(frameRGB);
         }
+    } else {
+        const float none[] = {0, 0, 0};
+        writeTrace(none);
     }
 
     rescanFlag = false;
 
     frameGray.copyTo(lastFrameGray);
+
+    stageTimes.total += getTickCount() - start;
+    stageTimes.frames++;
+}
+
+void RPPG::processTrace(const TraceSample &sample) {
+
+    // Set time
+    this->time = sample.time;
+
+    const int64 start = getTickCount();
+
+    if (sample.faceValid) {
+        faceValid = true;
+        rescanFlag = sample.rescan;
+        frameMotion = sample.motion;
+        frameSaturated = sample.saturated;
+        updateSignal(sample.values);
+    } else if (faceValid) {
+        invalidateFace();
+    }
+
+    rescanFlag = false;
+
+    stageTimes.total += getTickCount() - start;
+    stageTimes.frames++;
+}
+
+void RPPG::setTracer(LatencyTracer *tracer) {
+    this->latencyTracer = tracer;
+}
+
+void RPPG::setPublisher(RingPublisher *publisher, int stream) {
+    this->publisher = publisher;
+    this->stream = stream;
+}
+
+void RPPG::setLoad(const degradationLevel degradation, const double lag) {
+    if (degradation != this->degradation) {
+        cout << "Degradation level " << this->degradation << " -> " << degradation << ", lag=" << lag << " s" << endl;
+    }
+    this->degradation = degradation;
+    this->lag = lag;
+}
+
+void RPPG::writeTrace(const float values[3]) {
+
+    if (!traceWriter.isOpen()) {
+        return;
+    }
+
+    TraceSample sample;
+    sample.time = time;
+    sample.values[0] = values[0];
+    sample.values[1] = values[1];
+    sample.values[2] = values[2];
+    sample.motion = frameMotion;
+    sample.faceValid = faceValid;
+    sample.rescan = rescanFlag;
+    sample.saturated = faceValid && frameSaturated;
+    traceWriter.write(sample);
+}
+
+void RPPG::updateSignal(const float values[3]) {
+
+    int64 tick = getTickCount();
+
+    // Add new values to raw signal buffer, on the uniform grid if resampling
+    if (resampleRate > 0) {
+        resampleSample(values, time, rescanFlag);
+    } else {
+        addSample(values, time, rescanFlag);
+    }
+
+    endStage(stageTimes.sample, "sample", tick);
+
+    // If valid signal is large enough: estimate at the hop rate
+    if (s.rows >= fps * minSignalSize) {
+
+        const double hop = degradation >= lengthenHop ? max(estimationHop, (double)DEGRADED_ESTIMATION_HOP) : estimationHop;
+        if (lastEstimationTime == 0 || (time - lastEstimationTime) * timeBase >= hop) {
+            lastEstimationTime = time;
+
+            // Update band spectrum limits
+            low = (int)(s.rows * LOW_BPM / SEC_PER_MIN / fps);
+            high = min((int)(s.rows * HIGH_BPM / SEC_PER_MIN / fps) + 1, s.rows / 2);
+
+            // Weights of the patches, applied from the next rescan
+            if (patchGrid.area() > 1) {
+                updatePatchWeights();
+            }
+
+            // Quality of the window
+            motion = motionSum / s.rows;
+            saturation = (double)saturatedCount / s.rows;
+
+            if (qualityMode && (motion > MAX_MOTION || saturation > MAX_SATURATION)) {
+
+                cout << "Skipping estimation, motion=" << motion << " saturation=" << saturation << endl;
+                snr = numeric_limits<double>::quiet_NaN();
+                accepted = false;
+
+            } else {
+
+                // Filtering
+                tick = getTickCount();
+                (this->*extractor)();
+                endStage(stageTimes.extract, "extract", tick);
+
+                // HR estimation
+                tick = getTickCount();
+                estimateHeartrate();
+                endStage(stageTimes.estimate, "estimate", tick);
+            }
+        }
+
+        // Sample the latest estimates
+        tick = getTickCount();
+        sampleHeartrate();
+        endStage(stageTimes.estimate, "sample_rate", tick);
+
+        // Log
+        tick = getTickCount();
+        log();
+        publish();
+        endStage(stageTimes.emit, "emit", tick);
+    }
+}
+
+void RPPG::endStage(int64 &total, const char *name, int64 start) {
+    const int64 end = getTickCount();
+    total += end - start;
+    if (latencyTracer) {
+        latencyTracer->span(name, start, end);
+    }
+}
+
+void RPPG::addSample(const float values[3], int64_t time, bool rescan) {
+
+    // Update fps
+    fps = resampleRate > 0 ? resampleRate : getFps(t, timeBase);
+
+    // Remove old values from raw signal buffer
+    int dropped = 0;
+    while (resampleRate > 0 ? s.rows >= resampleSize : s.rows > fps * maxSignalSize) {
+        dropped++;
+        push(s);
+        push(t);
+        push(re);
+        if (!s_c.empty()) push(s_c);
+        if (!xy.empty()) push(xy);
+        if (!pulse.empty()) push(pulse);
+        motionSum -= motions(0, 0);
+        saturatedCount -= saturated(0, 0);
+        push(motions);
+        push(saturated);
+    }
+
+    assert(s.rows == t.rows && s.rows == re.rows);
+
+    // Add new values to raw signal buffer
+    s.push_back(Mat(1, 3, CV_32F, (void *)values));
+    sampleCount++;
+    t.push_back((double)time);
+
+    // Save rescan flag
+    re.push_back(rescan);
+
+    // Save quality indicators
+    motions.push_back(frameMotion);
+    saturated.push_back((uchar)frameSaturated);
+    motionSum += frameMotion;
+    saturatedCount += frameSaturated;
+
+    // Update fps
+    fps = resampleRate > 0 ? resampleRate : getFps(t, timeBase);
+
+    // Update the streaming state with the new sample
+    if (sampleUpdater) {
+        correctSample();
+        (this->*sampleUpdater)(dropped);
+    }
+}
+
+void RPPG::resampleSample(const float values[3], int64_t time, bool rescan) {
+
+    // Out of order or repeated timestamps carry no new information
+    if (!s.empty() && time <= lastRawTime) {
+        return;
+    }
+
+    const double step = 1 / (resampleRate * timeBase);
+
+    if (s.empty()) {
+        // First sample starts the grid
+        gridTime = time;
+        resamplePending = false;
+    } else {
+        // Interpolate between the last and the new sample at all grid points up to now.
+        // Across a rescan the old values are held, so the jump stays a single step
+        // flagged at the first grid point after it.
+        while (gridTime < time) {
+            const double w = rescan ? 0 : (gridTime - lastRawTime) / (double)(time - lastRawTime);
+            float v[3];
+            for (int c = 0; c < 3; c++) {
+                v[c] = (float)(lastRawValues[c] + w * (values[c] - lastRawValues[c]));
+            }
+            addSample(v, llround(gridTime), resamplePending);
+            resamplePending = false;
+            gridTime += step;
+        }
+        resamplePending = resamplePending || rescan;
+    }
+
+    if (gridTime == time) {
+        addSample(values, time, resamplePending);
+        resamplePending = false;
+        gridTime += step;
+    }
+
+    for (int c = 0; c < 3; c++) {
+        lastRawValues[c] = values[c];
+    }
+    lastRawTime = time;
 }
 
 void RPPG::detectFace(Mat &frameRGB, Mat &frameGray) {
@@ -234,7 +527,7 @@ void RPPG::setNearestBox(vector<Rect> boxes) {
     int index = 0;
     Point p = box.tl() - boxes.at(0).tl();
     int min = p.x * p.x + p.y * p.y;
-    for (int i = 1; i < boxes.size(); i++) {
+    for (int i = 1; i < (int)boxes.size(); i++) {
         p = box.tl() - boxes.at(i).tl();
         int d = p.x * p.x + p.y * p.y;
         if (d < min) {
@@ -316,6 +609,9 @@ void RPPG::trackFace(Mat &frameGray) {
 
         if (transform.total() > 0) {
 
+            // Motion of the face relative to its size
+            frameMotion = (float)(norm(Point2d(transform.at<double>(0, 2), transform.at<double>(1, 2))) / max(box.width, 1));
+
             // Update box
             Contour2f boxCoords;
             boxCoords.push_back(box.tl());
@@ -347,6 +643,176 @@ void RPPG::updateROI() {
                      Point(box.tl().x + 0.7 * box.width, box.tl().y + 0.25 * box.height));
 }
 
+void RPPG::samplePatches(const Mat &frameRGB, float values[3]) {
+
+    const int count = patchGrid.area();
+
+    // Grid cells follow the box, sampled where they overlap the frame
+    const Rect face(Point(box.x + PATCH_LEFT * box.width, box.y + PATCH_TOP * box.height),
+                    Point(box.x + PATCH_RIGHT * box.width, box.y + PATCH_BOTTOM * box.height));
+    const Rect region = face & Rect(0, 0, frameRGB.cols, frameRGB.rows);
+    const int eyesTop = box.y + EYES_TOP * box.height;
+    const int eyesBottom = box.y + EYES_BOTTOM * box.height;
+
+    patchSums.create(count, 7);
+    patchSums.setTo(0);
+
+    // Cell edges: columns split the face evenly, rows by the patch row of each pixel row
+    patchColumns.resize(patchGrid.width + 1);
+    for (int px = 0; px <= patchGrid.width; px++) {
+        patchColumns[px] = min(max(face.x + px * face.width / patchGrid.width, region.x), region.x + region.width);
+    }
+    patchRows.resize(patchGrid.height + 1);
+    for (int py = 0; py <= patchGrid.height; py++) {
+        const int y = face.y + (py * face.height + patchGrid.height - 1) / patchGrid.height;
+        patchRows[py] = min(max(y, region.y), region.y + region.height);
+    }
+
+    // Each cell is reduced above and below the eyes, every pixel of the face read once
+    for (int py = 0; py < patchGrid.height; py++) {
+        for (int px = 0; px < patchGrid.width; px++) {
+
+            const int x0 = patchColumns[px];
+            const int x1 = patchColumns[px + 1];
+            if (x0 >= x1) continue;
+
+            const int spans[2][2] = {{patchRows[py], min(patchRows[py + 1], eyesTop)},
+                                     {max(patchRows[py], eyesBottom), patchRows[py + 1]}};
+            double *sums = patchSums.ptr<double>(py * patchGrid.width + px);
+
+            for (int k = 0; k < 2; k++) {
+
+                const int y0 = spans[k][0];
+                const int y1 = spans[k][1];
+                if (y0 >= y1) continue;
+
+                Scalar means, stddevs;
+                meanStdDev(frameRGB(Rect(x0, y0, x1 - x0, y1 - y0)), means, stddevs);
+                const double n = (double)(x1 - x0) * (y1 - y0);
+                for (int c = 0; c < 3; c++) {
+                    sums[c] += n * means(c);
+                    sums[3 + c] += n * (stddevs(c) * stddevs(c) + means(c) * means(c));
+                }
+                sums[6] += n;
+            }
+        }
+    }
+
+    // A new grid restarts the history, keeping its storage
+    if (patchMeans.cols != 3 * count) {
+        patchMeans = Mat1f::zeros(1, 3 * count);
+        patchWeights = Mat1d::ones(1, count);
+        patchPending = Mat1d::ones(1, count);
+        reserveRows(patchSignal, windowCapacity, 3 * count, CV_32F);
+        reserveRows(patchRescans, windowCapacity, 1, CV_8U);
+    }
+
+    // Means of the patches with pixels, the others hold their last ones
+    patchTotal.create(1, 7);
+    patchTotal.setTo(0);
+    for (int p = 0; p < count; p++) {
+        const double *sums = patchSums.ptr<double>(p);
+        if (sums[6] > 0) {
+            for (int c = 0; c < 3; c++) {
+                patchMeans(0, 3 * p + c) = (float)(sums[c] / sums[6]);
+            }
+            patchTotal += patchSums.row(p);
+        }
+    }
+
+    // The grid is unusable if a channel is largely clipped or too dark
+    frameSaturated = false;
+    if (patchTotal(0, 6) > 0) {
+        for (int c = 0; c < 3; c++) {
+            const double mean = patchTotal(0, c) / patchTotal(0, 6);
+            const double stddev = sqrt(max(patchTotal(0, 3 + c) / patchTotal(0, 6) - mean * mean, 0.0));
+            frameSaturated = frameSaturated || mean + SATURATION_SIGMA * stddev >= 255 || mean <= DARK_LEVEL;
+        }
+    }
+
+    // Levels, scale and weights change only at a rescan, where the jump they
+    // cause is removed with the region's; the history is kept and its jumps
+    // are removed like those of the raw signal
+    if (patchLevels.empty() || rescanFlag) {
+        patchMeans.copyTo(patchLevels);
+        patchPending.copyTo(patchWeights);
+        for (int c = 0; c < 3; c++) {
+            double level = 0;
+            int levels = 0;
+            for (int p = 0; p < count; p++) {
+                const float mu = patchLevels(0, 3 * p + c);
+                if (mu <= 0) continue;
+                level += mu;
+                levels++;
+            }
+            patchScale[c] = levels > 0 ? level / levels : 0;
+        }
+    }
+
+    if (fps > 0) {
+        while (patchSignal.rows >= fps * maxSignalSize) {
+            push(patchSignal);
+            push(patchRescans);
+        }
+    }
+    patchSignal.push_back(patchMeans);
+    patchRescans.push_back((uchar)rescanFlag);
+
+    // Weighted mean of the patches relative to their levels, at the mean level
+    for (int c = 0; c < 3; c++) {
+        double relative = 0, weights = 0;
+        for (int p = 0; p < count; p++) {
+            const float mu = patchLevels(0, 3 * p + c);
+            if (mu <= 0) continue;
+            const double w = patchWeights(0, p);
+            relative += w * patchMeans(0, 3 * p + c) / mu;
+            weights += w;
+        }
+        values[c] = weights > 0 ? (float)(patchScale[c] * relative / weights) : 0;
+    }
+}
+
+void RPPG::updatePatchWeights() {
+
+    if (patchSignal.rows < fps * minSignalSize) {
+        return;
+    }
+
+    const int count = patchGrid.area();
+    const int rows = patchSignal.rows;
+    const int bandLow = (int)(rows * LOW_BPM / SEC_PER_MIN / fps);
+    const int bandHigh = min((int)(rows * HIGH_BPM / SEC_PER_MIN / fps) + 1, rows / 2);
+
+    // Without the jumps at rescans the window is continuous, each patch
+    // relative to its mean over it
+    denoise(patchSignal, patchRescans, patchDenoised);
+    reduce(patchDenoised, patchWindowLevels, 0, REDUCE_AVG);
+
+    // The weights wait for the next rescan, so they never step the signal
+    Mat1f green, spectrum;
+    for (int p = 0; p < count; p++) {
+
+        const float level = patchWindowLevels(0, 3 * p + 1);
+        if (level <= 0) {
+            patchPending(0, p) = 0;
+            continue;
+        }
+
+        // Weight by the SNR of the pulse peak in the relative green signal
+        patchDenoised.col(3 * p + 1).convertTo(green, CV_32F, 1 / level, -1);
+        detrend(green, green, fps);
+        timeToFrequency(green, spectrum, true);
+
+        const int total = spectrum.rows;
+        const int low = min(bandLow, total - 1);
+        Point peak;
+        minMaxLoc(spectrum.rowRange(low, min(bandHigh + 1, total)), NULL, NULL, NULL, &peak);
+        const double patchSnr = spectralSnr(spectrum, peak.y + low, bandLow, bandHigh);
+
+        patchPending(0, p) = std::isfinite(patchSnr) ? pow(10, std::min(std::max(patchSnr, (double)MIN_SNR), (double)MAX_SNR) / 10) : 0;
+    }
+}
+
 void RPPG::updateMask(Mat &frameGray) {
 
     cout << "Update mask" << endl;
@@ -357,145 +823,364 @@ void RPPG::updateMask(Mat &frameGray) {
 
 void RPPG::invalidateFace() {
 
-    s = Mat1d();
-    s_f = Mat1d();
-    t = Mat1d();
-    re = Mat1b();
-    powerSpectrum = Mat1d();
+    // Sample buffers keep their storage, appending up to the window does not allocate
+    reserveRows(s, windowCapacity, 3, CV_32F);
+    reserveRows(t, windowCapacity, 1, CV_64F);
+    reserveRows(re, windowCapacity, 1, CV_8U);
+    reserveRows(s_c, windowCapacity, 3, CV_32F);
+    reserveRows(xy, windowCapacity, 6, CV_32F);
+    reserveRows(pulse, windowCapacity, 1, CV_32F);
+    reserveRows(motions, windowCapacity, 1, CV_32F);
+    reserveRows(saturated, windowCapacity, 1, CV_8U);
+    s_f = Mat1f();
+    powerSpectrum = Mat1f();
+    motionSum = 0;
+    saturatedCount = 0;
+    // The patch history restarts with the next patch means
+    patchMeans = Mat1f();
+    patchLevels = Mat1f();
+    patchWeights = Mat1d();
+    patchPending = Mat1d();
+    xFilter.reset();
+    yFilter.reset();
+    streamingPca.reset();
+    lastEstimationTime = 0;
+    welchSpectrum.reset();
     faceValid = false;
 }
 
-void RPPG::extractSignal_g() {
+void RPPG::correctSample() {
 
-    // Denoise
-    Mat s_den = Mat(s.rows, 1, CV_64F);
-    denoise(s.col(1), re, s_den);
+    const float *v = s.ptr<float>(s.rows - 1);
 
-    // Normalise
-    normalization(s_den, s_den);
+    if (s.rows == 1) {
+        // First sample anchors the reference levels
+        for (int c = 0; c < 3; c++) {
+            streamRef[c] = v[c] > 0 ? v[c] : 1;
+            streamOffset[c] = 0;
+        }
+    } else if (re(re.rows - 1, 0)) {
+        // Eliminate the jump at the input, like denoise does on the window
+        for (int c = 0; c < 3; c++) {
+            streamOffset[c] += v[c] - streamLast[c];
+        }
+    }
 
-    // Detrend
-    Mat s_det = Mat(s_den.rows, s_den.cols, CV_64F);
-    detrend(s_den, s_det, fps);
+    float values[3];
+    for (int c = 0; c < 3; c++) {
+        streamLast[c] = v[c];
+        values[c] = v[c] - streamOffset[c];
+    }
+    s_c.push_back(Mat(1, 3, CV_32F, values));
+}
 
-    // Moving average
-    Mat s_mav = Mat(s_det.rows, s_det.cols, CV_64F);
-    movingAverage(s_det, s_mav, 3, fmax(floor(fps/6), 2));
+void RPPG::filterSample(int dropped) {
 
-    s_mav.copyTo(s_f);
+    const float *v = s_c.ptr<float>(s_c.rows - 1);
 
-    // Logging
-    if (logMode) {
-        std::ofstream log;
-        std::ostringstream filepath;
-        filepath << logfilepath << "_signal_" << time << ".csv";
-        log.open(filepath.str());
-        log << "re;g;g_den;g_det;g_mav\n";
-        for (int i = 0; i < s.rows; i++) {
-            log << re.at<bool>(i, 0) << ";";
-            log << s.at<double>(i, 1) << ";";
-            log << s_den.at<double>(i, 0) << ";";
-            log << s_det.at<double>(i, 0) << ";";
-            log << s_mav.at<double>(i, 0) << "\n";
-        }
-        log.close();
+    if (s.rows == 1) {
+        xFilter.reset();
+        yFilter.reset();
     }
+
+    // Redesign only when the frame rate drifts beyond tolerance
+    if (s.rows > 1 && (!xFilter.designed() || fabs(fps - xFilter.fs()) > IIR_FPS_TOLERANCE * xFilter.fs())) {
+        xFilter.design((double)LOW_BPM / SEC_PER_MIN, (double)HIGH_BPM / SEC_PER_MIN, fps, IIR_ORDER);
+        yFilter.design((double)LOW_BPM / SEC_PER_MIN, (double)HIGH_BPM / SEC_PER_MIN, fps, IIR_ORDER);
+    }
+
+    // Normalize by reference levels
+    float n[3];
+    for (int c = 0; c < 3; c++) {
+        n[c] = v[c] / streamRef[c] - 1;
+    }
+
+    // Calculate X_s and Y_s samples and filter them
+    float x = 3 * n[0] - 2 * n[1];
+    float y = 1.5f * n[0] + n[1] - 1.5f * n[2];
+    float values[] = {x, y,
+                      xFilter.designed() ? xFilter.filter(x) : 0,
+                      yFilter.designed() ? yFilter.filter(y) : 0,
+                      0, 0};
+    xy.push_back(Mat(1, 6, CV_32F, values));
+
+    // Update the moving averages near the ends, all of it if the kernel changed
+    int mavSize = s.rows > 1 ? fmax(floor(fps/6), 2) : 2;
+    int added = 1;
+    if (s.rows == 1 || mavSize != streamMavSize) {
+        streamMavSize = mavSize;
+        added = xy.rows;
+    }
+    movingAverageUpdate(xy.col(2), xy.col(4), 3, mavSize, dropped, added);
+    movingAverageUpdate(xy.col(3), xy.col(5), 3, mavSize, dropped, added);
 }
 
-void RPPG::extractSignal_pca() {
+template<void (*Projection)(InputArray, OutputArray)>
+void RPPG::projectSample(int) {
 
-    // Denoise signals
-    Mat s_den = Mat(s.rows, s.cols, CV_64F);
-    denoise(s, re, s_den);
+    pulse.push_back(0.0f);
 
-    // Normalize signals
-    normalization(s_den, s_den);
+    // Sub-window of the most recent samples
+    const int size = s_c.rows > 1 ? max((int)(fps * PULSE_WINDOW_SIZE), 2) : 2;
+    if (s_c.rows < size) {
+        return;
+    }
+    Mat window = s_c.rowRange(s_c.rows - size, s_c.rows);
 
-    // Detrend
-    Mat s_det = Mat(s.rows, s.cols, CV_64F);
-    detrend(s_den, s_det, fps);
+    // Project the sub-window to a pulse
+    workspace.bind(pulseWindow, size, 1);
+    Projection(window, pulseWindow);
 
-    // PCA to reduce dimensionality
-    Mat s_pca = Mat(s.rows, 1, CV_32F);
-    Mat pc = Mat(s.rows, s.cols, CV_32F);
-    pcaComponent(s_det, s_pca, pc, low, high);
+    // Overlap-add into the pulse signal
+    Mat tail = pulse.rowRange(pulse.rows - size, pulse.rows);
+    tail += pulseWindow;
+}
 
-    // Moving average
-    Mat s_mav = Mat(s.rows, 1, CV_32F);
-    movingAverage(s_pca, s_mav, 3, fmax(floor(fps/6), 2));
+/* SIGNAL EXTRACTION
+ *
+ * Each algorithm is a pipeline of stages: input -> denoise -> normalize ->
+ * detrend -> project -> smooth. A stage maps the output of the previous one
+ * into its own buffer; Skip passes it through and compiles away. Pipelines are
+ * instantiated per algorithm and selected in load() and when a shared window
+ * replaces denoise and normalize. */
+
+struct RPPG::AllChannels {
+    static Mat apply(RPPG &r) { return r.s; }
+};
+
+struct RPPG::GreenChannel {
+    static Mat apply(RPPG &r) { return r.s.col(1); }
+};
+
+struct RPPG::Skip {
+    static Mat apply(RPPG &, const Mat &a) { return a; }
+};
+
+struct RPPG::Denoise {
+    static Mat apply(RPPG &r, const Mat &a) {
+        denoise(a, r.re, r.s_den);
+        return r.s_den;
+    }
+};
 
-    s_mav.copyTo(s_f);
+struct RPPG::Normalize {
+    static Mat apply(RPPG &r, const Mat &a) {
+        normalization(a, r.s_n);
+        return r.s_n;
+    }
+};
+
+// Denoise and normalize all channels once per window for every RPPG sharing
+// it; a single column input is the green channel
+struct RPPG::SharedNormalize {
+    static Mat apply(RPPG &r, const Mat &a) {
+        SharedWindow &w = *r.sharedWindow;
+        if (w.time != r.time || w.rows != r.s.rows) {
+            denoise(r.s, r.re, w.denoised);
+            normalization(w.denoised, w.normalized);
+            w.time = r.time;
+            w.rows = r.s.rows;
+        }
+        r.s_n = a.cols == 1 ? w.normalized.col(1) : w.normalized;
+        return r.s_n;
+    }
+};
 
-    // Logging
-    if (logMode) {
-        std::ofstream log;
-        std::ostringstream filepath;
-        filepath << logfilepath << "_signal_" << time << ".csv";
-        log.open(filepath.str());
-        log << "re;r;g;b;r_den;g_den;b_den;r_det;g_det;b_det;pc1;pc2;pc3;s_pca;s_mav\n";
-        for (int i = 0; i < s.rows; i++) {
-            log << re.at<bool>(i, 0) << ";";
-            log << s.at<double>(i, 0) << ";";
-            log << s.at<double>(i, 1) << ";";
-            log << s.at<double>(i, 2) << ";";
-            log << s_den.at<double>(i, 0) << ";";
-            log << s_den.at<double>(i, 1) << ";";
-            log << s_den.at<double>(i, 2) << ";";
-            log << s_det.at<double>(i, 0) << ";";
-            log << s_det.at<double>(i, 1) << ";";
-            log << s_det.at<double>(i, 2) << ";";
-            log << pc.at<double>(i, 0) << ";";
-            log << pc.at<double>(i, 1) << ";";
-            log << pc.at<double>(i, 2) << ";";
-            log << s_pca.at<double>(i, 0) << ";";
-            log << s_mav.at<double>(i, 0) << "\n";
+struct RPPG::Detrend {
+    static Mat apply(RPPG &r, const Mat &a) {
+        detrend(a, r.s_det, r.fps);
+        return r.s_det;
+    }
+};
+
+// PCA to reduce dimensionality
+struct RPPG::PcaBatch {
+    static Mat apply(RPPG &r, const Mat &a) {
+        if (r.logMode) {
+            pcaComponent(a, r.s_pca, r.pc, r.low, r.high);
+        } else {
+            pcaComponent(a, r.s_pca, noArray(), r.low, r.high);
         }
-        log.close();
+        return r.s_pca;
     }
-}
+};
 
-void RPPG::extractSignal_xminay() {
+struct RPPG::PcaTracked {
+    static Mat apply(RPPG &r, const Mat &a) {
+        if (r.logMode) {
+            r.streamingPca.component(a, r.s_pca, r.pc, r.low, r.high, PCA_MAX_ANGLE);
+        } else {
+            r.streamingPca.component(a, r.s_pca, noArray(), r.low, r.high, PCA_MAX_ANGLE);
+        }
+        return r.s_pca;
+    }
+};
 
-    // Denoise signals
-    Mat s_den = Mat(s.rows, s.cols, CV_64F);
-    denoise(s, re, s_den);
+struct RPPG::Xminay {
+    static Mat apply(RPPG &r, const Mat &a) {
 
-    // Normalize raw signals
-    Mat s_n = Mat(s_den.rows, s_den.cols, CV_64F);
-    normalization(s_den, s_n);
+        // Separate channels into contiguous signals
+        split(a.reshape(3), r.rgb);
 
-    // Calculate X_s signal
-    Mat x_s = Mat(s.rows, s.cols, CV_64F);
-    addWeighted(s_n.col(0), 3, s_n.col(1), -2, 0, x_s);
+        // Calculate X_s signal
+        combine(r.rgb[0], 3, r.rgb[1], -2, r.x_s);
 
-    // Calculate Y_s signal
-    Mat y_s = Mat(s.rows, s.cols, CV_64F);
-    addWeighted(s_n.col(0), 1.5, s_n.col(1), 1, 0, y_s);
-    addWeighted(y_s, 1, s_n.col(2), -1.5, 0, y_s);
+        // Calculate Y_s signal
+        combine(r.rgb[0], 1.5, r.rgb[1], 1, r.y_s);
+        combine(r.y_s, 1, r.rgb[2], -1.5, r.y_s);
 
-    // Bandpass
-    Mat x_f = Mat(s.rows, s.cols, CV_32F);
-    bandpass(x_s, x_f, low, high);
-    x_f.convertTo(x_f, CV_64F);
-    Mat y_f = Mat(s.rows, s.cols, CV_32F);
-    bandpass(y_s, y_f, low, high);
-    y_f.convertTo(y_f, CV_64F);
+        // Bandpass
+        bandpass(r.x_s, r.x_f, r.low, r.high, true);
+        bandpass(r.y_s, r.y_f, r.low, r.high, true);
 
-    // Calculate alpha
-    Scalar mean_x_f;
-    Scalar stddev_x_f;
-    meanStdDev(x_f, mean_x_f, stddev_x_f);
-    Scalar mean_y_f;
-    Scalar stddev_y_f;
-    meanStdDev(y_f, mean_y_f, stddev_y_f);
-    double alpha = stddev_x_f.val[0]/stddev_y_f.val[0];
+        return tune(r);
+    }
 
-    // Calculate signal
-    Mat xminay = Mat(s.rows, 1, CV_64F);
-    addWeighted(x_f, 1, y_f, -alpha, 0, xminay);
+    // Calculate alpha and the signal
+    static Mat tune(RPPG &r) {
+        double mean_x_f, stddev_x_f;
+        dsp::meanStdDev(r.x_f.ptr<float>(), r.x_f.rows, mean_x_f, stddev_x_f);
+        double mean_y_f, stddev_y_f;
+        dsp::meanStdDev(r.y_f.ptr<float>(), r.y_f.rows, mean_y_f, stddev_y_f);
+        r.alpha = stddev_x_f/stddev_y_f;
+        combine(r.x_f, 1, r.y_f, -r.alpha, r.s_xminay);
+        return r.s_xminay;
+    }
+};
+
+// Signals were filtered sample by sample
+struct RPPG::StreamedXminay {
+    static Mat apply(RPPG &r, const Mat &) {
+        r.xy.col(0).copyTo(r.x_s);
+        r.xy.col(1).copyTo(r.y_s);
+        r.xy.col(2).copyTo(r.x_f);
+        r.xy.col(3).copyTo(r.y_f);
+        return Xminay::tune(r);
+    }
+};
 
-    // Moving average
-    movingAverage(xminay, s_f, 3, fmax(floor(fps/6), 2));
+// Pulse was projected and overlap-added sample by sample
+struct RPPG::StreamedPulse {
+    static Mat apply(RPPG &r, const Mat &) { return r.pulse; }
+};
+
+struct RPPG::MovingAverage {
+    static Mat apply(RPPG &r, const Mat &a) {
+        movingAverage(a, r.s_mav, 3, fmax(floor(r.fps/6), 2));
+        return r.s_mav;
+    }
+};
+
+// Moving averages of x_f and y_f were updated sample by sample
+struct RPPG::StreamedMovingAverage {
+    static Mat apply(RPPG &r, const Mat &) {
+        r.xy.col(4).copyTo(r.x_mav);
+        r.xy.col(5).copyTo(r.y_mav);
+        combine(r.x_mav, 1, r.y_mav, -r.alpha, r.s_mav);
+        return r.s_mav;
+    }
+};
+
+/* SIGNAL LOGS */
+
+struct RPPG::GLog {
+    static void write(RPPG &r, std::ostream &log) {
+        log << "re;g;g_den;g_det;g_mav\n";
+        for (int i = 0; i < r.s.rows; i++) {
+            log << r.re.at<bool>(i, 0) << ";";
+            log << r.s.at<float>(i, 1) << ";";
+            log << r.s_n.at<float>(i, 0) << ";";
+            log << r.s_det.at<float>(i, 0) << ";";
+            log << r.s_mav.at<float>(i, 0) << "\n";
+        }
+    }
+};
+
+struct RPPG::PcaLog {
+    static void write(RPPG &r, std::ostream &log) {
+        log << "re;r;g;b;r_den;g_den;b_den;r_det;g_det;b_det;pc1;pc2;pc3;s_pca;s_mav\n";
+        for (int i = 0; i < r.s.rows; i++) {
+            log << r.re.at<bool>(i, 0) << ";";
+            log << r.s.at<float>(i, 0) << ";";
+            log << r.s.at<float>(i, 1) << ";";
+            log << r.s.at<float>(i, 2) << ";";
+            log << r.s_n.at<float>(i, 0) << ";";
+            log << r.s_n.at<float>(i, 1) << ";";
+            log << r.s_n.at<float>(i, 2) << ";";
+            log << r.s_det.at<float>(i, 0) << ";";
+            log << r.s_det.at<float>(i, 1) << ";";
+            log << r.s_det.at<float>(i, 2) << ";";
+            log << r.pc.at<float>(i, 0) << ";";
+            log << r.pc.at<float>(i, 1) << ";";
+            log << r.pc.at<float>(i, 2) << ";";
+            log << r.s_pca.at<float>(i, 0) << ";";
+            log << r.s_mav.at<float>(i, 0) << "\n";
+        }
+    }
+};
+
+struct RPPG::XminayLog {
+    static void write(RPPG &r, std::ostream &log) {
+        // The streamed variant does not denoise the window
+        denoise(r.s, r.re, r.s_den);
+        log << "r;g;b;r_den;g_den;b_den;x_s;y_s;x_f;y_f;s;s_f\n";
+        for (int i = 0; i < r.s.rows; i++) {
+            log << r.s.at<float>(i, 0) << ";";
+            log << r.s.at<float>(i, 1) << ";";
+            log << r.s.at<float>(i, 2) << ";";
+            log << r.s_den.at<float>(i, 0) << ";";
+            log << r.s_den.at<float>(i, 1) << ";";
+            log << r.s_den.at<float>(i, 2) << ";";
+            log << r.x_s.at<float>(i, 0) << ";";
+            log << r.y_s.at<float>(i, 0) << ";";
+            log << r.x_f.at<float>(i, 0) << ";";
+            log << r.y_f.at<float>(i, 0) << ";";
+            log << r.s_xminay.at<float>(i, 0) << ";";
+            log << r.s_f.at<float>(i, 0) << "\n";
+        }
+    }
+};
+
+struct RPPG::PulseLog {
+    static void write(RPPG &r, std::ostream &log) {
+        log << "re;r;g;b;r_c;g_c;b_c;s_f\n";
+        for (int i = 0; i < r.s.rows; i++) {
+            log << r.re.at<bool>(i, 0) << ";";
+            log << r.s.at<float>(i, 0) << ";";
+            log << r.s.at<float>(i, 1) << ";";
+            log << r.s.at<float>(i, 2) << ";";
+            log << r.s_c.at<float>(i, 0) << ";";
+            log << r.s_c.at<float>(i, 1) << ";";
+            log << r.s_c.at<float>(i, 2) << ";";
+            log << r.s_f.at<float>(i, 0) << "\n";
+        }
+    }
+};
+
+// Point the stage buffers at the workspace for the current window
+void RPPG::bindBuffers(int rows, int cols) {
+    workspace.bind(s_den, rows, cols);
+    workspace.bind(s_n, rows, cols);
+    workspace.bind(s_det, rows, cols);
+    workspace.bind(pc, rows, 3);
+    Mat *buffers[] = {&s_pca, &s_mav, &rgb[0], &rgb[1], &rgb[2], &x_s, &y_s, &x_f, &y_f,
+                      &s_xminay, &x_mav, &y_mav, &s_f};
+    for (Mat *buffer : buffers) {
+        workspace.bind(*buffer, rows, 1);
+    }
+}
+
+template<class In, class Den, class Norm, class Det, class Proj, class Smooth, class Logger>
+void RPPG::extractSignal() {
+
+    Mat a = In::apply(*this);
+    bindBuffers(a.rows, a.cols);
+    a = Den::apply(*this, a);
+    a = Norm::apply(*this, a);
+    a = Det::apply(*this, a);
+    a = Proj::apply(*this, a);
+    a = Smooth::apply(*this, a);
+    a.copyTo(s_f);
 
     // Logging
     if (logMode) {
@@ -503,47 +1188,94 @@ void RPPG::extractSignal_xminay() {
         std::ostringstream filepath;
         filepath << logfilepath << "_signal_" << time << ".csv";
         log.open(filepath.str());
-        log << "r;g;b;r_den;g_den;b_den;x_s;y_s;x_f;y_f;s;s_f\n";
-        for (int i = 0; i < s.rows; i++) {
-            log << s.at<double>(i, 0) << ";";
-            log << s.at<double>(i, 1) << ";";
-            log << s.at<double>(i, 2) << ";";
-            log << s_den.at<double>(i, 0) << ";";
-            log << s_den.at<double>(i, 1) << ";";
-            log << s_den.at<double>(i, 2) << ";";
-            log << x_s.at<double>(i, 0) << ";";
-            log << y_s.at<double>(i, 0) << ";";
-            log << x_f.at<double>(i, 0) << ";";
-            log << y_f.at<double>(i, 0) << ";";
-            log << xminay.at<double>(i, 0) << ";";
-            log << s_f.at<double>(i, 0) << "\n";
-        }
+        Logger::write(*this, log);
         log.close();
     }
 }
 
-void RPPG::estimateHeartrate() {
+RPPG::Extractor RPPG::selectExtractor() const {
 
-    powerSpectrum = cv::Mat(s_f.size(), CV_32F);
-    timeToFrequency(s_f, powerSpectrum, true);
+    switch (rPPGAlg) {
+        case g:
+            if (sharedWindow) {
+                return &RPPG::extractSignal<GreenChannel, Skip, SharedNormalize, Detrend, Skip, MovingAverage, GLog>;
+            }
+            return &RPPG::extractSignal<GreenChannel, Denoise, Normalize, Detrend, Skip, MovingAverage, GLog>;
+        case pca:
+            if (pcaAlg == tracked) {
+                if (sharedWindow) {
+                    return &RPPG::extractSignal<AllChannels, Skip, SharedNormalize, Detrend, PcaTracked, MovingAverage, PcaLog>;
+                }
+                return &RPPG::extractSignal<AllChannels, Denoise, Normalize, Detrend, PcaTracked, MovingAverage, PcaLog>;
+            }
+            if (sharedWindow) {
+                return &RPPG::extractSignal<AllChannels, Skip, SharedNormalize, Detrend, PcaBatch, MovingAverage, PcaLog>;
+            }
+            return &RPPG::extractSignal<AllChannels, Denoise, Normalize, Detrend, PcaBatch, MovingAverage, PcaLog>;
+        case xminay:
+            if (bandpassAlg == iir) {
+                return &RPPG::extractSignal<AllChannels, Skip, Skip, Skip, StreamedXminay, StreamedMovingAverage, XminayLog>;
+            }
+            if (sharedWindow) {
+                return &RPPG::extractSignal<AllChannels, Skip, SharedNormalize, Skip, Xminay, MovingAverage, XminayLog>;
+            }
+            return &RPPG::extractSignal<AllChannels, Denoise, Normalize, Skip, Xminay, MovingAverage, XminayLog>;
+        case pos:
+        case chrom:
+            return &RPPG::extractSignal<AllChannels, Skip, Skip, Skip, StreamedPulse, Skip, PulseLog>;
+    }
+    return 0;
+}
 
-    // band mask
-    const int total = s_f.rows;
-    Mat bandMask = Mat::zeros(s_f.size(), CV_8U);
-    bandMask.rowRange(min(low, total), min(high, total) + 1).setTo(ONE);
+RPPG::SampleUpdater RPPG::selectSampleUpdater() const {
+
+    if (rPPGAlg == xminay && bandpassAlg == iir) {
+        return &RPPG::filterSample;
+    } else if (rPPGAlg == pos) {
+        return &RPPG::projectSample<posProjection>;
+    } else if (rPPGAlg == chrom) {
+        return &RPPG::projectSample<chromProjection>;
+    }
+    return 0;
+}
+
+void RPPG::estimateHeartrate() {
+
+    if (estimatorAlg == welch) {
+        welchEstimate();
+    } else {
+        workspace.bind(powerSpectrum, s_f.rows, 1);
+        timeToFrequency(s_f, powerSpectrum, true);
+        spectrumLow = low;
+        spectrumHigh = high;
+    }
 
     if (!powerSpectrum.empty()) {
 
+        // band
+        const int total = powerSpectrum.rows;
+        const int bandLow = min(spectrumLow, total - 1);
+        Mat band = powerSpectrum.rowRange(bandLow, min(spectrumHigh + 1, total));
+
         // grab index of max power spectrum
         double min, max;
         Point pmin, pmax;
-        minMaxLoc(powerSpectrum, &min, &max, &pmin, &pmax, bandMask);
-
-        // calculate BPM
-        bpm = pmax.y * fps / total * SEC_PER_MIN;
-        bpms.push_back(bpm);
+        minMaxLoc(band, &min, &max, &pmin, &pmax);
+        pmax.y += bandLow;
+
+        // calculate BPM from the peak refined to sub-bin accuracy
+        double peak = pmax.y + (interpolateMode ? interpolatePeak(powerSpectrum, pmax.y) : 0);
+        bpm = peak * fps / total * SEC_PER_MIN;
+
+        // Accept the estimate if the peak stands out from the band
+        snr = spectralSnr(powerSpectrum, pmax.y, spectrumLow, spectrumHigh);
+        accepted = !qualityMode || snr >= MIN_SNR;
+        if (accepted) {
+            bpms.push_back(bpm);
+            bpmWeights.push_back(qualityMode ? pow(10, std::min(snr, (double)MAX_SNR) / 10) : 1.0);
+        }
 
-        cout << "FPS=" << fps << " Vals=" << powerSpectrum.rows << " Peak=" << pmax.y << " BPM=" << bpm << endl;
+        cout << "FPS=" << fps << " Vals=" << powerSpectrum.rows << " Peak=" << peak << " BPM=" << bpm << " SNR=" << snr << endl;
 
         // Logging
         if (logMode) {
@@ -553,52 +1285,139 @@ void RPPG::estimateHeartrate() {
             log.open(filepath.str());
             log << "i;powerSpectrum\n";
             for (int i = 0; i < powerSpectrum.rows; i++) {
-                if (low <= i && i <= high) {
+                if (spectrumLow <= i && i <= spectrumHigh) {
                     log << i << ";";
-                    log << powerSpectrum.at<double>(i, 0) << "\n";
+                    log << powerSpectrum.at<float>(i, 0) << "\n";
                 }
             }
             log.close();
         }
     }
+}
+
+void RPPG::welchEstimate() {
+
+    // Segments of half the minimum window overlapping by half, so the first
+    // estimate already averages three of them. Redesign on frame rate drift.
+    if (!welchSpectrum.configured() || fabs(fps - welchFps) > IIR_FPS_TOLERANCE * welchFps) {
+        const int size = max((int)(fps * minSignalSize / 2), WELCH_MIN_SEGMENT_SIZE);
+        welchFps = fps;
+        welchSpectrum.configure(size, size / 2, sampleUpdater == &RPPG::filterSample ? 2 : 1);
+    }
+
+    // Band limits in segment bins
+    const int length = welchSpectrum.segmentLength();
+    spectrumLow = (int)(length * LOW_BPM / SEC_PER_MIN / fps);
+    spectrumHigh = min((int)(length * HIGH_BPM / SEC_PER_MIN / fps) + 1, length / 2);
+
+    if (sampleUpdater == &RPPG::filterSample) {
+        // The filtered x and y samples are final, so completed segments are reused
+        // and only the weights follow alpha
+        welchSpectrum.update(xy.colRange(2, 4), sampleCount - xy.rows, true);
+        const double weights[] = {1, -alpha};
+        welchSpectrum.spectrum(weights, powerSpectrum);
+    } else {
+        // The extracted signal changes with the whole window, so all segments are transformed
+        welchSpectrum.update(s_f, sampleCount - s_f.rows, false);
+        const double weights[] = {1};
+        welchSpectrum.spectrum(weights, powerSpectrum);
+    }
+}
 
-    if ((time - lastSamplingTime) * timeBase >= 1/samplingFrequency) {
+void RPPG::sampleHeartrate() {
+
+    if (!bpms.empty() && (time - lastSamplingTime) * timeBase >= 1/samplingFrequency) {
         lastSamplingTime = time;
 
-        cv::sort(bpms, bpms, SORT_EVERY_COLUMN);
+        // average calculated BPMs since last sampling time, weighted by their SNR
+        meanBpm = bpms.dot(bpmWeights) / sum(bpmWeights)(0);
 
-        // average calculated BPMs since last sampling time
-        meanBpm = mean(bpms)(0);
+        cv::sort(bpms, bpms, SORT_EVERY_COLUMN);
         minBpm = bpms.at<double>(0, 0);
         maxBpm = bpms.at<double>(bpms.rows-1, 0);
 
         std::cout << "meanBPM=" << meanBpm << " minBpm=" << minBpm << " maxBpm=" << maxBpm << std::endl;
 
         bpms.pop_back(bpms.rows);
+        bpmWeights.pop_back(bpmWeights.rows);
     }
 }
 
 void RPPG::log() {
 
+    if (!logfile.is_open()) {
+        return;
+    }
+
     if (lastSamplingTime == time || lastSamplingTime == 0) {
         logfile << time << ";";
         logfile << faceValid << ";";
         logfile << meanBpm << ";";
         logfile << minBpm << ";";
-        logfile << maxBpm << "\n";
+        logfile << maxBpm << ";";
+        logfile << lag << ";";
+        logfile << degradation << "\n";
         logfile.flush();
     }
 
     logfileDetailed << time << ";";
     logfileDetailed << faceValid << ";";
-    logfileDetailed << bpm << "\n";
+    logfileDetailed << bpm << ";";
+    logfileDetailed << snr << ";";
+    logfileDetailed << motion << ";";
+    logfileDetailed << saturation << ";";
+    logfileDetailed << accepted << ";";
+    logfileDetailed << lag << ";";
+    logfileDetailed << degradation << "\n";
     logfileDetailed.flush();
 }
 
+void RPPG::publish() {
+
+    // Once per estimation window
+    if (!publisher || lastEstimationTime != time) {
+        return;
+    }
+
+    RingRecord record;
+    record.time = time;
+    record.stream = stream;
+    record.face = 0;
+    record.bpm = bpm;
+    record.meanBpm = meanBpm;
+    record.minBpm = minBpm;
+    record.maxBpm = maxBpm;
+    record.snr = snr;
+    record.motion = motion;
+    record.saturation = saturation;
+    record.accepted = accepted;
+    record.faceValid = faceValid;
+    record.x = box.x;
+    record.y = box.y;
+    record.width = box.width;
+    record.height = box.height;
+    publisher->publish(record);
+}
+
 void RPPG::draw(cv::Mat &frameRGB) {
 
-    // Draw roi
-    rectangle(frameRGB, roi, GREEN);
+    // Draw roi, or the patches brighter with their weight
+    if (patchGrid.area() > 1 && !patchWeights.empty()) {
+        double maxWeight;
+        minMaxLoc(patchWeights, NULL, &maxWeight);
+        const Rect face(Point(box.x + PATCH_LEFT * box.width, box.y + PATCH_TOP * box.height),
+                        Point(box.x + PATCH_RIGHT * box.width, box.y + PATCH_BOTTOM * box.height));
+        for (int py = 0; py < patchGrid.height; py++) {
+            for (int px = 0; px < patchGrid.width; px++) {
+                const Rect patch(Point(face.x + px * face.width / patchGrid.width, face.y + py * face.height / patchGrid.height),
+                                 Point(face.x + (px + 1) * face.width / patchGrid.width, face.y + (py + 1) * face.height / patchGrid.height));
+                const double w = maxWeight > 0 ? patchWeights(0, py * patchGrid.width + px) / maxWeight : 0;
+                rectangle(frameRGB, patch, Scalar(0, 255 * w, 0));
+            }
+        }
+    } else {
+        rectangle(frameRGB, roi, GREEN);
+    }
 
     // Draw bounding box
     rectangle(frameRGB, box, RED);
@@ -618,26 +1437,24 @@ void RPPG::draw(cv::Mat &frameRGB) {
         double widthMult = displayWidth/(s_f.rows - 1);
         double drawAreaTlX = box.tl().x + box.width + 20;
         double drawAreaTlY = box.tl().y;
-        Point p1(drawAreaTlX, drawAreaTlY + (vmax - s_f.at<double>(0, 0))*heightMult);
+        Point p1(drawAreaTlX, drawAreaTlY + (vmax - s_f.at<float>(0, 0))*heightMult);
         Point p2;
         for (int i = 1; i < s_f.rows; i++) {
-            p2 = Point(drawAreaTlX + i * widthMult, drawAreaTlY + (vmax - s_f.at<double>(i, 0))*heightMult);
+            p2 = Point(drawAreaTlX + i * widthMult, drawAreaTlY + (vmax - s_f.at<float>(i, 0))*heightMult);
             line(frameRGB, p1, p2, RED, 2);
             p1 = p2;
         }
 
         // Draw powerSpectrum
-        const int total = s_f.rows;
-        Mat bandMask = Mat::zeros(s_f.size(), CV_8U);
-        bandMask.rowRange(min(low, total), min(high, total) + 1).setTo(ONE);
-        minMaxLoc(powerSpectrum, &vmin, &vmax, &pmin, &pmax, bandMask);
+        const int total = powerSpectrum.rows;
+        minMaxLoc(powerSpectrum.rowRange(min(spectrumLow, total - 1), min(spectrumHigh + 1, total)), &vmin, &vmax);
         heightMult = displayHeight/(vmax - vmin);
-        widthMult = displayWidth/(high - low);
+        widthMult = displayWidth/(spectrumHigh - spectrumLow);
         drawAreaTlX = box.tl().x + box.width + 20;
         drawAreaTlY = box.tl().y + box.height/2.0;
-        p1 = Point(drawAreaTlX, drawAreaTlY + (vmax - powerSpectrum.at<double>(low, 0))*heightMult);
-        for (int i = low + 1; i <= high; i++) {
-            p2 = Point(drawAreaTlX + (i - low) * widthMult, drawAreaTlY + (vmax - powerSpectrum.at<double>(i, 0)) * heightMult);
+        p1 = Point(drawAreaTlX, drawAreaTlY + (vmax - powerSpectrum.at<float>(spectrumLow, 0))*heightMult);
+        for (int i = spectrumLow + 1; i <= spectrumHigh; i++) {
+            p2 = Point(drawAreaTlX + (i - spectrumLow) * widthMult, drawAreaTlY + (vmax - powerSpectrum.at<float>(i, 0)) * heightMult);
             line(frameRGB, p1, p2, RED, 2);
             p1 = p2;
         }
@@ -658,7 +1475,7 @@ void RPPG::draw(cv::Mat &frameRGB) {
     putText(frameRGB, ss.str(), Point(box.tl().x, box.br().y + 40), FONT_HERSHEY_PLAIN, 2, GREEN, 2);
 
     // Draw corners
-    for (int i = 0; i < corners.size(); i++) {
+    for (int i = 0; i < (int)corners.size(); i++) {
         //circle(frameRGB, corners[i], r, WHITE, -1, 8, 0);
         line(frameRGB, Point(corners[i].x-5,corners[i].y), Point(corners[i].x+5,corners[i].y), GREEN, 1);
         line(frameRGB, Point(corners[i].x,corners[i].y-5), Point(corners[i].x,corners[i].y+5), GREEN, 1);
@@ -14,14 +14,77 @@
 #include <opencv2/objdetect.hpp>
 #include <opencv2/dnn.hpp>
 
+#include "opencv.hpp"
+#include "Trace.hpp"
+#include "Scheduler.hpp"
+#include "Latency.hpp"
+#include "Ring.hpp"
+
 #include <stdio.h>
 
 using namespace cv;
 using namespace dnn;
 using namespace std;
 
-enum rPPGAlgorithm { g, pca, xminay };
+enum rPPGAlgorithm { g, pca, xminay, pos, chrom };
 enum faceDetAlgorithm { haar, deep };
+enum bandpassAlgorithm { fft, iir };
+enum pcaAlgorithm { batch, tracked };
+enum estimatorAlgorithm { periodogram, welch };
+
+// Settings of a pipeline, named so call sites read without a signature at
+// hand; the defaults are those of the command line
+struct RPPGSettings {
+
+    // Algorithms
+    rPPGAlgorithm rPPGAlg = g;
+    faceDetAlgorithm faceDetAlg = haar;
+    bandpassAlgorithm bandpassAlg = fft;
+    pcaAlgorithm pcaAlg = batch;
+    estimatorAlgorithm estimatorAlg = periodogram;
+
+    // Input
+    int width = 0;
+    int height = 0;
+    double timeBase = 0.001;
+    int downsample = 1;
+
+    // Windows and rates; sizes in seconds, frequencies in Hz
+    double samplingFrequency = 1;
+    double rescanFrequency = 1;
+    int minSignalSize = 5;
+    int maxSignalSize = 5;
+    double estimationHop = 0;
+    double resampleRate = 0;
+
+    // Refine the spectral peak between bins; off reports the bin itself
+    bool interpolate = true;
+
+    // Quality gating and the ROI patch grid
+    bool quality = false;
+    Size patchGrid = Size(1, 1);
+
+    // Files; no logs without logPath, no trace without tracePath and no face
+    // detector without its model paths, as for replaying traces
+    string logPath;
+    string haarPath;
+    string dnnProtoPath;
+    string dnnModelPath;
+    string tracePath;
+
+    bool log = false;
+    bool gui = false;
+};
+
+// Denoised and normalized window of all channels, shared by RPPGs that are fed
+// the same samples with the same window settings. The first one to extract a
+// window computes it and the others read it, so they must run on one thread.
+struct SharedWindow {
+    int64_t time = -1;
+    int rows = 0;
+    Mat1f denoised;
+    Mat1f normalized;
+};
 
 class RPPG {
 
@@ -31,18 +94,49 @@ public:
     RPPG() {;}
 
     // Load Settings
-    bool load(const rPPGAlgorithm rPPGAlg, const faceDetAlgorithm faceDetAlg,
-              const int width, const int height, const double timeBase, const int downsample,
-              const double samplingFrequency, const double rescanFrequency,
-              const int minSignalSize, const int maxSignalSize,
-              const string &logPath, const string &haarPath,
-              const string &dnnProtoPath, const string &dnnModelPath,
-              const bool log, const bool gui);
+    bool load(const RPPGSettings &settings);
+
+    void processFrame(Mat &frameRGB, Mat &frameGray, int64_t time);
+
+    // Feed a recorded sample straight into the signal stages
+    void processTrace(const TraceSample &sample);
+
+    // Work to shed for live streams and their lag behind capture in seconds
+    void setLoad(const degradationLevel degradation, const double lag);
+
+    // Record the span of every stage, none if null
+    void setTracer(LatencyTracer *tracer);
 
-    void processFrame(Mat &frameRGB, Mat &frameGray, int time);
+    // Publish every estimate as the given stream, none if null
+    void setPublisher(RingPublisher *publisher, int stream);
+
+    // Take the denoised and normalized window from a shared one, none if null
+    void setSharedWindow(SharedWindow *shared);
 
     void exit();
 
+    // Prefix of the log files written for these settings
+    static string logfilePath(const RPPGSettings &settings);
+
+    // Ticks spent per stage, accumulated over all processed frames
+    struct StageTimes {
+        int64 face;     // detection and tracking
+        int64 sample;   // ROI means and per-sample updates
+        int64 extract;  // signal extraction
+        int64 estimate; // spectrum, peak and sampling
+        int64 emit;     // logging the results
+        int64 total;
+        int frames;
+    };
+
+    const StageTimes &getStageTimes() const { return stageTimes; }
+    bool isFaceValid() const { return faceValid; }
+    double getMeanBpm() const { return meanBpm; }
+    double getBpm() const { return bpm; }
+    double getSnr() const { return snr; }
+    double getFrameRate() const { return fps; }
+    int64_t getLastSamplingTime() const { return lastSamplingTime; }
+
     typedef vector<Point2f> Contour2f;
 
 private:
@@ -53,17 +147,69 @@ private:
     void trackFace(Mat &frameGray);
     void updateMask(Mat &frameGray);
     void updateROI();
-    void extractSignal_g();
-    void extractSignal_pca();
-    void extractSignal_xminay();
+    void samplePatches(const Mat &frameRGB, float values[3]);
+    void updatePatchWeights();
+    void endStage(int64 &total, const char *name, int64 start);
+    void writeTrace(const float values[3]);
+    void updateSignal(const float values[3]);
+    void addSample(const float values[3], int64_t time, bool rescan);
+    void resampleSample(const float values[3], int64_t time, bool rescan);
+    void correctSample();
+    void filterSample(int dropped);
+    template<void (*Projection)(InputArray, OutputArray)>
+    void projectSample(int dropped);
     void estimateHeartrate();
+    void welchEstimate();
+    void sampleHeartrate();
     void draw(Mat &frameRGB);
     void invalidateFace();
     void log();
+    void publish();
 
     // The algorithm
     rPPGAlgorithm rPPGAlg;
 
+    // Signal extraction pipeline stages
+    struct AllChannels;
+    struct GreenChannel;
+    struct Skip;
+    struct Denoise;
+    struct Normalize;
+    struct SharedNormalize;
+    struct Detrend;
+    struct PcaBatch;
+    struct PcaTracked;
+    struct Xminay;
+    struct StreamedXminay;
+    struct StreamedPulse;
+    struct MovingAverage;
+    struct StreamedMovingAverage;
+    struct GLog;
+    struct PcaLog;
+    struct XminayLog;
+    struct PulseLog;
+
+    template<class In, class Den, class Norm, class Det, class Proj, class Smooth, class Logger>
+    void extractSignal();
+    void bindBuffers(int rows, int cols);
+
+    // The pipeline and per-sample streaming update of the algorithm, selected in load()
+    typedef void (RPPG::*Extractor)();
+    typedef void (RPPG::*SampleUpdater)(int dropped);
+    Extractor selectExtractor() const;
+    SampleUpdater selectSampleUpdater() const;
+    Extractor extractor;
+    SampleUpdater sampleUpdater;
+
+    // The bandpass used by xminay
+    bandpassAlgorithm bandpassAlg;
+
+    // The component selection used by pca
+    pcaAlgorithm pcaAlg;
+
+    // The spectral estimator
+    estimatorAlgorithm estimatorAlg;
+
     // The classifier
     faceDetAlgorithm faceDetAlg;
     CascadeClassifier haarClassifier;
@@ -75,9 +221,16 @@ private:
     int minSignalSize;
     double rescanFrequency;
     double samplingFrequency;
+    double estimationHop;
+    double resampleRate;
+    int resampleSize;
     double timeBase;
     bool logMode;
     bool guiMode;
+    bool qualityMode;
+    bool interpolateMode;
+    degradationLevel degradation;
+    double lag;
 
     // State variables
     int64_t time;
@@ -85,6 +238,7 @@ private:
     int high;
     int64_t lastSamplingTime;
     int64_t lastScanTime;
+    int64_t lastEstimationTime;
     int low;
     int64_t now;
     bool faceValid;
@@ -99,20 +253,122 @@ private:
     Mat1b mask;
     Rect roi;
 
+    // Patch grid over forehead and cheeks, one pass over the face per frame;
+    // per patch and over all of them the sums of B, G, R, their squares and
+    // the pixel count
+    Size patchGrid;
+    Mat1d patchSums;
+    Mat1d patchTotal;
+    vector<int> patchColumns;
+    vector<int> patchRows;
+
+    // Patch means per raw frame, held while a patch is empty, with their
+    // rescan flags; the levels, scale and quality weights they are combined
+    // with change only at a rescan, the weights estimated in between wait
+    Mat1f patchMeans;
+    Mat1f patchSignal;
+    Mat1b patchRescans;
+    Mat1f patchDenoised;
+    Mat1f patchWindowLevels;
+    Mat1f patchLevels;
+    double patchScale[3];
+    Mat1d patchWeights;
+    Mat1d patchPending;
+
     // Raw signal
-    Mat1d s;
+    Mat1f s;
     Mat1d t;
     Mat1b re;
 
+    // Storage of the window-sized buffers
+    Workspace workspace;
+    int windowCapacity;
+
+    // Filter chain buffers, reused across frames
+    Mat1f s_den;
+    Mat1f s_n;
+    Mat1f s_det;
+    Mat1f s_pca;
+    Mat1f pc;
+    Mat1f s_mav;
+    Mat rgb[3];
+    Mat1f x_s;
+    Mat1f y_s;
+    Mat1f x_f;
+    Mat1f y_f;
+    Mat1f s_xminay;
+
+    // Resampling state; gridTime is the next grid point in time base units
+    double gridTime;
+    int64_t lastRawTime;
+    float lastRawValues[3];
+    bool resamplePending;
+
+    // Jump-corrected raw signal for the streaming paths
+    Mat1f s_c;
+    StreamingPCA streamingPca;
+
+    // Streaming bandpass state; xy holds x_s, y_s, x_f, y_f and the moving
+    // averages of x_f and y_f per raw sample
+    IIRBandpass xFilter;
+    IIRBandpass yFilter;
+    float streamRef[3];
+    float streamOffset[3];
+    float streamLast[3];
+    int streamMavSize;
+    Mat1f xy;
+    Mat1f x_mav;
+    Mat1f y_mav;
+
+    // Overlap-added pulse of pos and chrom per raw sample
+    Mat1f pulse;
+    Mat1f pulseWindow;
+
+    // Signal quality per raw sample, with running totals over the window
+    float frameMotion;
+    bool frameSaturated;
+    Mat1f motions;
+    Mat1b saturated;
+    double motionSum;
+    int saturatedCount;
+
+    // Quality of the last estimation window
+    double snr;
+    double motion;
+    double saturation;
+    bool accepted;
+
     // Estimation
-    Mat1d s_f;
+    Mat1f s_f;
     Mat1d bpms;
-    Mat1d powerSpectrum;
+    Mat1d bpmWeights;
+    Mat1f powerSpectrum;
+    int spectrumLow;
+    int spectrumHigh;
+    double alpha;
+
+    // Welch estimator state; sampleCount is the absolute index of the next sample
+    WelchSpectrum welchSpectrum;
+    double welchFps;
+    int64_t sampleCount;
     double bpm = 0.0;
     double meanBpm;
     double minBpm;
     double maxBpm;
 
+    StageTimes stageTimes;
+    LatencyTracer *latencyTracer = nullptr;
+
+    // Window prefix computed once for several pipelines
+    SharedWindow *sharedWindow = nullptr;
+
+    // Result ring
+    RingPublisher *publisher = nullptr;
+    int stream = 0;
+
+    // Raw sample recording
+    TraceWriter traceWriter;
+
     // Logfiles
     ofstream logfile;
     ofstream logfileDetailed;
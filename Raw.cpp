@@ -0,0 +1,122 @@
+//
+//  Raw.cpp
+//  Heartbeat
+//
+//  Created by Philipp Rouast on 19/10/2026.
+//  Copyright © 2026 Philipp Roüast. All rights reserved.
+//
+
+#include "Raw.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <opencv2/imgproc.hpp>
+
+using namespace cv;
+using namespace std;
+
+bool RawVideo::open(const string &path, const rawFormat format,
+                    const int width, const int height, const double fps,
+                    const string &timestampsPath) {
+
+    close();
+
+    // NV12 subsamples chroma by two in both directions
+    if (width <= 0 || height <= 0 || fps <= 0 ||
+        (format == nv12 && (width % 2 != 0 || height % 2 != 0))) {
+        return false;
+    }
+
+    fd = path == "-" ? STDIN_FILENO : ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    if (timestampsPath != "") {
+        timestamps.open(timestampsPath.c_str());
+        if (!timestamps.is_open()) {
+            close();
+            return false;
+        }
+    }
+
+    this->format = format;
+    this->width = width;
+    this->height = height;
+    this->fps = fps;
+    this->index = 0;
+
+    // BGR frames are read straight into the output, the others need a buffer
+    switch (format) {
+        case bgr24:
+            buffer.release();
+            break;
+        case gray:
+            buffer.create(height, width, CV_8UC1);
+            break;
+        case nv12:
+            buffer.create(height * 3 / 2, width, CV_8UC1);
+            break;
+    }
+
+    return true;
+}
+
+bool RawVideo::readFully(uchar *data, size_t size) {
+
+    // Pipes deliver a frame in several reads
+    while (size > 0) {
+        const ssize_t n = ::read(fd, data, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool RawVideo::read(Mat &frame, int64_t &time) {
+
+    if (fd < 0) {
+        return false;
+    }
+
+    // No-op after the first frame
+    frame.create(height, width, CV_8UC3);
+
+    if (format == bgr24) {
+        if (!frame.isContinuous() || !readFully(frame.data, frame.total() * frame.elemSize())) {
+            return false;
+        }
+    } else {
+        if (!readFully(buffer.data, buffer.total())) {
+            return false;
+        }
+        cvtColor(buffer, frame, format == gray ? COLOR_GRAY2BGR : COLOR_YUV2BGR_NV12);
+    }
+
+    if (timestamps.is_open()) {
+        if (!(timestamps >> time)) {
+            return false;
+        }
+    } else {
+        time = (int64_t)(index * 1000 / fps + 0.5);
+    }
+
+    index++;
+    return true;
+}
+
+void RawVideo::close() {
+
+    if (fd >= 0 && fd != STDIN_FILENO) {
+        ::close(fd);
+    }
+    fd = -1;
+
+    if (timestamps.is_open()) {
+        timestamps.close();
+    }
+}
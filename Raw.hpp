@@ -0,0 +1,70 @@
+//
+//  Raw.hpp
+//  Heartbeat
+//
+//  Created by Philipp Rouast on 19/10/2026.
+//  Copyright © 2026 Philipp Roüast. All rights reserved.
+//
+
+#ifndef Raw_hpp
+#define Raw_hpp
+
+#include <stdint.h>
+#include <fstream>
+#include <string>
+#include <opencv2/core.hpp>
+
+#include <stdio.h>
+
+enum rawFormat { bgr24, gray, nv12 };
+
+/* RAW VIDEO
+ *
+ * Fixed-size uncompressed frames from stdin or a named pipe, as written by
+ * ffmpeg with -f rawvideo. Frames are read into a buffer allocated once and
+ * converted to BGR in place of the previous frame. Frame times in ms follow
+ * the frame index and rate, or are read one per line from a side channel
+ * written alongside the frames. */
+
+class RawVideo {
+
+public:
+
+    RawVideo() {;}
+    ~RawVideo() { close(); }
+
+    // Path "-" reads stdin; timestamps are optional
+    bool open(const std::string &path, const rawFormat format,
+              const int width, const int height, const double fps,
+              const std::string &timestampsPath = "");
+
+    // Next frame in BGR and its time in ms; false at the end of the stream
+    bool read(cv::Mat &frame, int64_t &time);
+
+    void close();
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    double getFps() const { return fps; }
+
+private:
+
+    RawVideo(const RawVideo &);
+    RawVideo &operator=(const RawVideo &);
+
+    bool readFully(uchar *data, size_t size);
+
+    // Settings
+    rawFormat format;
+    int width;
+    int height;
+    double fps;
+
+    // State
+    int fd = -1;
+    int64_t index;
+    cv::Mat buffer;
+    std::ifstream timestamps;
+};
+
+#endif /* Raw_hpp */
@@ -0,0 +1,214 @@
+//
+//  Ring.cpp
+//  Heartbeat
+//
+//  Created by Philipp Rouast on 19/10/2026.
+//  Copyright © 2026 Philipp Roüast. All rights reserved.
+//
+
+#include "Ring.hpp"
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define RING_MAGIC 0x52524248 // "HBRR"
+#define RING_VERSION 1
+
+using namespace std;
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "the ring needs lock-free 64-bit atomics to work across processes");
+
+struct RingHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t capacity;
+    uint32_t recordSize;
+    atomic<uint64_t> written;
+    atomic<uint32_t> closed;
+};
+
+struct RingSlot {
+    atomic<uint64_t> sequence;
+    RingRecord record;
+};
+
+static string objectName(const string &name) {
+    return name.empty() || name[0] == '/' ? name : "/" + name;
+}
+
+static size_t ringSize(uint32_t capacity) {
+    return sizeof(RingHeader) + capacity * sizeof(RingSlot);
+}
+
+static RingSlot *ringSlots(const RingHeader *header) {
+    return (RingSlot *)((char *)header + sizeof(RingHeader));
+}
+
+bool RingPublisher::open(const string &name, int capacity) {
+
+    close();
+
+    if (capacity <= 0) {
+        return false;
+    }
+
+    // A fresh object, readers of a previous run keep their own mapping
+    this->name = objectName(name);
+    shm_unlink(this->name.c_str());
+    const int fd = shm_open(this->name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        return false;
+    }
+
+    const size_t size = ringSize(capacity);
+    void *memory = MAP_FAILED;
+    if (ftruncate(fd, size) == 0) {
+        memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+
+    if (memory == MAP_FAILED) {
+        shm_unlink(this->name.c_str());
+        return false;
+    }
+
+    // The object is zero-filled, so all slots start out empty
+    header = (RingHeader *)memory;
+    header->magic = RING_MAGIC;
+    header->version = RING_VERSION;
+    header->capacity = capacity;
+    header->recordSize = sizeof(RingRecord);
+    header->written.store(0, memory_order_relaxed);
+    header->closed.store(0, memory_order_release);
+    slots = ringSlots(header);
+    this->size = size;
+
+    return true;
+}
+
+void RingPublisher::publish(const RingRecord &record) {
+
+    if (!header) {
+        return;
+    }
+
+    const uint64_t n = header->written.load(memory_order_relaxed);
+    RingSlot &slot = slots[n % header->capacity];
+
+    // Odd while writing, so readers discard a copy taken meanwhile
+    slot.sequence.store(2 * n + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memcpy(&slot.record, &record, sizeof(RingRecord));
+    slot.sequence.store(2 * (n + 1), memory_order_release);
+
+    header->written.store(n + 1, memory_order_release);
+}
+
+void RingPublisher::close() {
+
+    if (!header) {
+        return;
+    }
+
+    header->closed.store(1, memory_order_release);
+    munmap(header, size);
+    shm_unlink(name.c_str());
+    header = NULL;
+    slots = NULL;
+}
+
+bool RingReader::open(const string &name, bool fromOldest) {
+
+    close();
+
+    const int fd = shm_open(objectName(name).c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    void *memory = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(RingHeader)) {
+        memory = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+
+    if (memory == MAP_FAILED) {
+        return false;
+    }
+
+    header = (const RingHeader *)memory;
+    size = st.st_size;
+
+    if (header->magic != RING_MAGIC || header->version != RING_VERSION ||
+        header->recordSize != sizeof(RingRecord) || header->capacity == 0 ||
+        ringSize(header->capacity) != size) {
+        close();
+        return false;
+    }
+
+    slots = ringSlots(header);
+
+    const uint64_t written = header->written.load(memory_order_acquire);
+    next = fromOldest && written > header->capacity ? written - header->capacity : (fromOldest ? 0 : written);
+    dropped = 0;
+
+    return true;
+}
+
+bool RingReader::read(RingRecord &record) {
+
+    if (!header) {
+        return false;
+    }
+
+    const uint64_t capacity = header->capacity;
+
+    while (true) {
+
+        const uint64_t written = header->written.load(memory_order_acquire);
+        if (next >= written) {
+            return false;
+        }
+
+        // Lapped by the writer: continue with the oldest record still held
+        if (written - next > capacity) {
+            dropped += written - capacity - next;
+            next = written - capacity;
+        }
+
+        const RingSlot &slot = slots[next % capacity];
+        const uint64_t expected = 2 * (next + 1);
+
+        const uint64_t before = slot.sequence.load(memory_order_acquire);
+        memcpy(&record, &slot.record, sizeof(RingRecord));
+        atomic_thread_fence(memory_order_acquire);
+        const uint64_t after = slot.sequence.load(memory_order_relaxed);
+
+        next++;
+        if (before == expected && after == expected) {
+            return true;
+        }
+
+        // Overwritten while copying
+        dropped++;
+    }
+}
+
+void RingReader::close() {
+
+    if (!header) {
+        return;
+    }
+
+    munmap((void *)header, size);
+    header = NULL;
+    slots = NULL;
+}
+
+bool RingReader::isClosed() const {
+    return !header || header->closed.load(memory_order_acquire) != 0;
+}
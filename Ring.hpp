@@ -0,0 +1,108 @@
+//
+//  Ring.hpp
+//  Heartbeat
+//
+//  Created by Philipp Rouast on 19/10/2026.
+//  Copyright © 2026 Philipp Roüast. All rights reserved.
+//
+
+#ifndef Ring_hpp
+#define Ring_hpp
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+
+#include <stdio.h>
+
+/* RESULT RING
+ *
+ * Heart rate estimates published into POSIX shared memory for consumers on
+ * the same host. One writer appends fixed-size records into a ring of
+ * slots, any number of readers follow it without locks. The header holds
+ * the number of records written so far; each slot holds a sequence word
+ * that is odd while the writer fills it and 2 * (n + 1) once it holds
+ * record n, so a reader detects a record overwritten under it and skips
+ * ahead instead of returning a torn copy. */
+
+#define RING_DEFAULT_CAPACITY 1024
+
+struct RingRecord {
+    int64_t time;       // in time base units of the stream
+    int32_t stream;
+    int32_t face;
+    double bpm;         // latest estimate
+    double meanBpm;     // sampled estimates
+    double minBpm;
+    double maxBpm;
+    double snr;         // dB, NaN if the window was skipped
+    double motion;
+    double saturation;
+    int32_t accepted;
+    int32_t faceValid;
+    int32_t x, y, width, height;  // face box in pixels
+};
+
+struct RingHeader;
+struct RingSlot;
+
+class RingPublisher {
+
+public:
+
+    RingPublisher() {;}
+    ~RingPublisher() { close(); }
+
+    // Create the shared memory object, replacing a stale one of the same name
+    bool open(const std::string &name, int capacity = RING_DEFAULT_CAPACITY);
+    void publish(const RingRecord &record);
+
+    // Mark the ring closed and remove its name; mapped readers still drain it
+    void close();
+    bool isOpen() const { return header != NULL; }
+
+private:
+
+    RingPublisher(const RingPublisher &);
+    RingPublisher &operator=(const RingPublisher &);
+
+    std::string name;
+    RingHeader *header = NULL;
+    RingSlot *slots = NULL;
+    size_t size = 0;
+};
+
+class RingReader {
+
+public:
+
+    RingReader() {;}
+    ~RingReader() { close(); }
+
+    // Attach to a ring, from the oldest record still held or from the next one
+    bool open(const std::string &name, bool fromOldest = false);
+
+    // Next record if one was published, false otherwise
+    bool read(RingRecord &record);
+
+    void close();
+
+    // Whether the writer closed the ring
+    bool isClosed() const;
+
+    // Records overwritten before this reader got to them
+    uint64_t getDropped() const { return dropped; }
+
+private:
+
+    RingReader(const RingReader &);
+    RingReader &operator=(const RingReader &);
+
+    const RingHeader *header = NULL;
+    const RingSlot *slots = NULL;
+    size_t size = 0;
+    uint64_t next = 0;
+    uint64_t dropped = 0;
+};
+
+#endif /* Ring_hpp */
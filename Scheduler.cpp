@@ -0,0 +1,82 @@
+//
+//  Scheduler.cpp
+//  Heartbeat
+//
+//  Created by Philipp Rouast on 19/10/2026.
+//  Copyright © 2026 Philipp Roüast. All rights reserved.
+//
+
+#include "Scheduler.hpp"
+
+#include <algorithm>
+
+#define LAG_BUDGET 2 // frame intervals of lag before shedding work
+#define RECOVER_LAG 0.5 // frame intervals of lag considered caught up
+#define CAUGHT_UP_WAIT 0.25 // frame intervals blocked on capture that mean the queue is empty
+#define ESCALATE_FRAMES 5 // frames at a level before shedding more
+#define RECOVER_FRAMES 60 // frames caught up before restoring work
+#define DROP_EVERY 2 // at the highest level, process one in this many frames
+#define CAPTURE_QUEUE_DEPTH 4 // frames the driver buffers before it drops the oldest
+
+void RealtimeScheduler::load(double frameInterval) {
+    this->frameInterval = frameInterval;
+    this->lag = 0;
+    this->level = nominal;
+    this->framesAtLevel = 0;
+    this->framesRecovered = 0;
+    this->dropCounter = 0;
+}
+
+double RealtimeScheduler::getMaxLag() const {
+    return CAPTURE_QUEUE_DEPTH * frameInterval;
+}
+
+void RealtimeScheduler::update(double waited, double worked, double age) {
+
+    if (age >= 0) {
+
+        // Measured from the capture timestamp
+        lag = age;
+
+    } else {
+
+        // Blocking on capture means no frames were queued
+        if (waited >= CAUGHT_UP_WAIT * frameInterval) {
+            lag = 0;
+        }
+
+        // Queue waiting time: grows by the work beyond one interval
+        lag += worked - frameInterval;
+    }
+
+    // The driver drops frames rather than queue more
+    lag = std::min(std::max(lag, 0.0), getMaxLag());
+
+    framesAtLevel++;
+
+    if (lag > LAG_BUDGET * frameInterval) {
+
+        framesRecovered = 0;
+        if (level < dropFrames && framesAtLevel >= ESCALATE_FRAMES) {
+            level = (degradationLevel)(level + 1);
+            framesAtLevel = 0;
+        }
+
+    } else if (lag < RECOVER_LAG * frameInterval) {
+
+        framesRecovered++;
+        if (level > nominal && framesRecovered >= RECOVER_FRAMES) {
+            level = (degradationLevel)(level - 1);
+            framesAtLevel = 0;
+            framesRecovered = 0;
+        }
+    }
+}
+
+bool RealtimeScheduler::dropFrame() {
+    if (level < dropFrames) {
+        dropCounter = 0;
+        return false;
+    }
+    return dropCounter++ % DROP_EVERY != 0;
+}
@@ -0,0 +1,59 @@
+//
+//  Scheduler.hpp
+//  Heartbeat
+//
+//  Created by Philipp Rouast on 19/10/2026.
+//  Copyright © 2026 Philipp Roüast. All rights reserved.
+//
+
+#ifndef Scheduler_hpp
+#define Scheduler_hpp
+
+#include <stdio.h>
+
+// Work shed in this order while a live stream falls behind
+enum degradationLevel { nominal, skipDrawing, lengthenHop, deferRescan, dropFrames };
+
+/* REAL-TIME SCHEDULER
+ *
+ * Tracks how far processing lags behind capture. When the driver stamps
+ * its buffers on our clock the lag is measured as the age of the frame
+ * when it is read. Otherwise it is modeled from the work time per frame:
+ * frames queue in the driver whenever work exceeds the frame interval and
+ * drain while it is shorter, so the lag follows the waiting time of a
+ * queue. Either way it is bounded by the frames the driver can hold. The
+ * degradation level rises while the lag exceeds the budget and falls
+ * again once it has stayed small for a while. */
+
+class RealtimeScheduler {
+
+public:
+
+    RealtimeScheduler() {;}
+
+    void load(double frameInterval);
+
+    // Account for one frame: time blocked waiting for it, time spent on it and
+    // its age when read, in seconds; a negative age means it is unknown
+    void update(double waited, double worked, double age = -1);
+
+    // Whether to skip processing the next frame
+    bool dropFrame();
+
+    degradationLevel getLevel() const { return level; }
+    double getLag() const { return lag; }
+
+    // Most lag the driver queue can hold, in seconds
+    double getMaxLag() const;
+
+private:
+
+    double frameInterval;
+    double lag;
+    degradationLevel level;
+    int framesAtLevel;
+    int framesRecovered;
+    int dropCounter;
+};
+
+#endif /* Scheduler_hpp */
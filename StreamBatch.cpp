@@ -0,0 +1,132 @@
+//
+//  StreamBatch.cpp
+//  Heartbeat
+//
+//  Created by Philipp Rouast on 19/10/2026.
+//  Copyright © 2026 Philipp Roüast. All rights reserved.
+//
+
+#include "StreamBatch.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "opencv.hpp"
+#include "dsp.hpp"
+
+#define LOW_BPM 42
+#define HIGH_BPM 240
+#define SEC_PER_MIN 60
+#define SMOOTH_PASSES 3
+
+using namespace cv;
+using namespace std;
+
+void StreamBatch::add(int id, const float *green, const unsigned char *rescans, int n, double fps) {
+
+    // Settings of the single-stream g pipeline for this window
+    Window w;
+    w.id = id;
+    w.offset = samples.size();
+    w.n = n;
+    w.fps = fps;
+    w.lambda = (int)fps;
+    w.smooth = (int)fmax(floor(fps / 6), 2);
+    w.low = (int)(n * LOW_BPM / SEC_PER_MIN / fps);
+    w.high = min((int)(n * HIGH_BPM / SEC_PER_MIN / fps) + 1, n / 2);
+    windows.push_back(w);
+
+    samples.insert(samples.end(), green, green + n);
+    this->rescans.insert(this->rescans.end(), rescans, rescans + n);
+}
+
+bool StreamBatch::sameGroup(const Window &a, const Window &b) {
+    return a.n == b.n && a.lambda == b.lambda && a.smooth == b.smooth && a.low == b.low && a.high == b.high;
+}
+
+void StreamBatch::run(vector<StreamEstimate> &estimates) {
+
+    estimates.resize(windows.size());
+
+    // Group the windows by their settings
+    vector<int> order(windows.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = (int)i;
+    }
+    const vector<Window> &w = windows;
+    sort(order.begin(), order.end(), [&w](int a, int b) {
+        if (w[a].n != w[b].n) return w[a].n < w[b].n;
+        if (w[a].lambda != w[b].lambda) return w[a].lambda < w[b].lambda;
+        if (w[a].smooth != w[b].smooth) return w[a].smooth < w[b].smooth;
+        if (w[a].low != w[b].low) return w[a].low < w[b].low;
+        return w[a].high < w[b].high;
+    });
+
+    vector<int> group;
+    for (size_t i = 0; i < order.size(); i++) {
+        group.push_back(order[i]);
+        if (i + 1 == order.size() || !sameGroup(windows[order[i]], windows[order[i + 1]])) {
+            runGroup(group, estimates);
+            group.clear();
+        }
+    }
+
+    windows.clear();
+    samples.clear();
+    rescans.clear();
+}
+
+void StreamBatch::runGroup(const vector<int> &group, vector<StreamEstimate> &estimates) {
+
+    const Window &settings = windows[group[0]];
+    const int n = settings.n;
+    const int count = (int)group.size();
+    const int lanes = (count + dsp::LANE_WIDTH - 1) / dsp::LANE_WIDTH * dsp::LANE_WIDTH;
+
+    // Transpose into lanes; padding lanes repeat the first subject
+    block.resize((size_t)n * lanes);
+    blockJumps.resize((size_t)n * lanes);
+    for (int k = 0; k < lanes; k++) {
+        const Window &w = windows[group[k < count ? k : 0]];
+        for (int i = 0; i < n; i++) {
+            block[(size_t)i * lanes + k] = samples[w.offset + i];
+            blockJumps[(size_t)i * lanes + k] = rescans[w.offset + i];
+        }
+    }
+
+    // Denoise, normalize, detrend and smooth like the g extractor
+    dsp::removeJumpsLanes(block.data(), blockJumps.data(), n, lanes);
+    dsp::normalizeLanes(block.data(), n, lanes);
+    dsp::detrendLanes(block.data(), n, lanes, settings.lambda);
+    for (int pass = 0; pass < SMOOTH_PASSES; pass++) {
+        dsp::boxFilterLanes(block.data(), n, lanes, settings.smooth);
+    }
+
+    // Only the band and its neighbours are transformed
+    const int bandLow = min(settings.low, n - 1);
+    const int first = max(bandLow - 1, 0);
+    const int last = min(settings.high + 1, n - 1);
+    magnitudes.resize((size_t)(last - first + 1) * lanes);
+    dsp::bandMagnitudeLanes(block.data(), n, lanes, first, last, magnitudes.data());
+
+    // Peak, refinement and SNR per subject as in RPPG::estimateHeartrate
+    spectrum.assign(last + 1, 0);
+    const Mat1f column(last + 1, 1, spectrum.data());
+    for (int k = 0; k < count; k++) {
+
+        for (int bin = first; bin <= last; bin++) {
+            spectrum[bin] = magnitudes[(size_t)(bin - first) * lanes + k];
+        }
+
+        int peak = bandLow;
+        for (int bin = bandLow + 1; bin <= min(settings.high, last); bin++) {
+            if (spectrum[bin] > spectrum[peak]) peak = bin;
+        }
+
+        const Window &w = windows[group[k]];
+        StreamEstimate &estimate = estimates[group[k]];
+        estimate.id = w.id;
+        estimate.bpm = (peak + interpolatePeak(column, peak)) * w.fps / n * SEC_PER_MIN;
+        estimate.snr = spectralSnr(column, peak, w.low, w.high);
+    }
+}
@@ -0,0 +1,83 @@
+//
+//  StreamBatch.hpp
+//  Heartbeat
+//
+//  Created by Philipp Rouast on 19/10/2026.
+//  Copyright © 2026 Philipp Roüast. All rights reserved.
+//
+
+#ifndef StreamBatch_hpp
+#define StreamBatch_hpp
+
+#include <vector>
+
+#include <stdio.h>
+
+/* STREAM BATCH
+ *
+ * Heart rate estimation for many subjects at once. Windows of the green
+ * channel are queued per subject and grouped by window length and frame
+ * rate. Each group is transposed into one structure-of-arrays block with a
+ * lane per subject and runs the g pipeline through the lane kernels
+ * together: jump removal, normalization, detrending, smoothing and the
+ * band of the magnitude spectrum, which ends at the Nyquist bin. Peak and
+ * SNR follow the single-stream estimator, so every subject gets the
+ * estimate its own RPPG with the g extractor and periodogram would, given
+ * the frame rate that RPPG measures over the window.
+ *
+ * It suits callers that hold many windows ending at the same time, such
+ * as several streams or faces in one process. BatchRunner does not use
+ * it, since each of its recordings is tracked by its own RPPG and its
+ * estimates fall at unrelated times. */
+
+struct StreamEstimate {
+    int id;
+    double bpm;
+    double snr;  // dB
+};
+
+class StreamBatch {
+
+public:
+
+    StreamBatch() {;}
+
+    // Queue n green samples of a subject with their rescan flags, sampled at fps
+    void add(int id, const float *green, const unsigned char *rescans, int n, double fps);
+
+    // Estimate every queued window, in the order they were added, and clear the queue
+    void run(std::vector<StreamEstimate> &estimates);
+
+    int size() const { return (int)windows.size(); }
+
+private:
+
+    // Windows with the same n, λ, smoothing and band share a block
+    struct Window {
+        int id;
+        size_t offset;
+        int n;
+        double fps;
+        int lambda;
+        int smooth;
+        int low;
+        int high;
+    };
+
+    static bool sameGroup(const Window &a, const Window &b);
+
+    void runGroup(const std::vector<int> &group, std::vector<StreamEstimate> &estimates);
+
+    // Queued windows
+    std::vector<Window> windows;
+    std::vector<float> samples;
+    std::vector<unsigned char> rescans;
+
+    // Group storage, reused across runs
+    std::vector<float> block;
+    std::vector<unsigned char> blockJumps;
+    std::vector<float> magnitudes;
+    std::vector<float> spectrum;
+};
+
+#endif /* StreamBatch_hpp */
@@ -0,0 +1,216 @@
+//
+//  Sweep.cpp
+//  Heartbeat
+//
+//  Created by Philipp Rouast on 19/10/2026.
+//  Copyright © 2026 Philipp Roüast. All rights reserved.
+//
+
+#include "Sweep.hpp"
+
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <thread>
+
+using namespace cv;
+using namespace std;
+
+static const char *RPPG_NAMES[] = {"g", "pca", "xminay", "pos", "chrom"};
+static const char *BANDPASS_NAMES[] = {"fft", "iir"};
+static const char *PCA_NAMES[] = {"batch", "tracked"};
+static const char *ESTIMATOR_NAMES[] = {"periodogram", "welch"};
+
+bool ParameterSweep::load(const string &tracePath) {
+
+    TraceReader trace;
+    if (!trace.open(tracePath)) {
+        return false;
+    }
+
+    samples.clear();
+    TraceSample sample;
+    while (trace.read(sample)) {
+        samples.push_back(sample);
+    }
+
+    this->timeBase = trace.getTimeBase();
+    return true;
+}
+
+bool ParameterSweep::sameWindows(const SweepConfig &a, const SweepConfig &b) {
+    return a.minSignalSize == b.minSignalSize && a.maxSignalSize == b.maxSignalSize &&
+           a.resampleRate == b.resampleRate;
+}
+
+// A configuration being evaluated and its running statistics
+struct SweepRun {
+    RPPG rppg;
+    int64 ticks = 0;
+    int estimates = 0;
+    double sum = 0, squareSum = 0, errorSum = 0, absSum = 0, errorSquareSum = 0;
+    double minBpm = numeric_limits<double>::quiet_NaN();
+    double maxBpm = numeric_limits<double>::quiet_NaN();
+};
+
+void ParameterSweep::evaluate(const vector<SweepConfig> &configs, const vector<size_t> &group,
+                              double truthBpm, vector<SweepResult> &results) const {
+
+    // The first pipeline to extract a window prepares it for the others
+    SharedWindow shared;
+
+    vector<unique_ptr<SweepRun> > runs;
+    for (size_t k = 0; k < group.size(); k++) {
+        const SweepConfig &config = configs[group[k]];
+
+        RPPGSettings settings;
+        settings.rPPGAlg = config.rPPGAlg;
+        settings.bandpassAlg = config.bandpassAlg;
+        settings.pcaAlg = config.pcaAlg;
+        settings.estimatorAlg = config.estimatorAlg;
+        settings.timeBase = timeBase;
+        settings.samplingFrequency = config.samplingFrequency;
+        settings.minSignalSize = config.minSignalSize;
+        settings.maxSignalSize = config.maxSignalSize;
+        settings.estimationHop = config.estimationHop;
+        settings.resampleRate = config.resampleRate;
+        settings.quality = config.quality;
+
+        const int64 start = getTickCount();
+        runs.push_back(unique_ptr<SweepRun>(new SweepRun()));
+        runs[k]->rppg.load(settings);
+        if (group.size() > 1) {
+            runs[k]->rppg.setSharedWindow(&shared);
+        }
+        runs[k]->ticks += getTickCount() - start;
+    }
+
+    // Collect the sampled heart rates, every configuration sample by sample
+    for (size_t i = 0; i < samples.size(); i++) {
+        for (size_t k = 0; k < runs.size(); k++) {
+            SweepRun &r = *runs[k];
+            const int64 start = getTickCount();
+            r.rppg.processTrace(samples[i]);
+            if (r.rppg.getLastSamplingTime() == samples[i].time && samples[i].time > 0) {
+                const double bpm = r.rppg.getMeanBpm();
+                r.sum += bpm;
+                r.squareSum += bpm * bpm;
+                r.minBpm = r.estimates == 0 ? bpm : std::min(r.minBpm, bpm);
+                r.maxBpm = r.estimates == 0 ? bpm : std::max(r.maxBpm, bpm);
+                if (truthBpm > 0) {
+                    const double error = bpm - truthBpm;
+                    r.errorSum += error;
+                    r.absSum += fabs(error);
+                    r.errorSquareSum += error * error;
+                }
+                r.estimates++;
+            }
+            r.ticks += getTickCount() - start;
+        }
+    }
+
+    const double nan = numeric_limits<double>::quiet_NaN();
+    for (size_t k = 0; k < runs.size(); k++) {
+        SweepRun &r = *runs[k];
+        r.rppg.exit();
+
+        SweepResult &result = results[group[k]];
+        const int estimates = r.estimates;
+        result.estimates = estimates;
+        result.meanBpm = estimates > 0 ? r.sum / estimates : nan;
+        result.sdBpm = estimates > 0 ? sqrt(std::max(r.squareSum / estimates - result.meanBpm * result.meanBpm, 0.0)) : nan;
+        result.minBpm = r.minBpm;
+        result.maxBpm = r.maxBpm;
+        result.mae = estimates > 0 && truthBpm > 0 ? r.absSum / estimates : nan;
+        result.rmse = estimates > 0 && truthBpm > 0 ? sqrt(r.errorSquareSum / estimates) : nan;
+        result.bias = estimates > 0 && truthBpm > 0 ? r.errorSum / estimates : nan;
+        result.seconds = r.ticks / getTickFrequency();
+    }
+}
+
+void ParameterSweep::run(const vector<SweepConfig> &configs, int threads, double truthBpm,
+                         vector<SweepResult> &results) {
+
+    results.resize(configs.size());
+
+    // Group the configurations by their windows
+    vector<vector<size_t> > groups;
+    for (size_t i = 0; i < configs.size(); i++) {
+        size_t g = 0;
+        while (g < groups.size() && !sameWindows(configs[groups[g][0]], configs[i])) {
+            g++;
+        }
+        if (g == groups.size()) {
+            groups.push_back(vector<size_t>());
+        }
+        groups[g].push_back(i);
+    }
+
+    // Halve the largest groups while workers would be left idle
+    while (!groups.empty() && (int)groups.size() < threads) {
+        size_t largest = 0;
+        for (size_t g = 1; g < groups.size(); g++) {
+            if (groups[g].size() > groups[largest].size()) largest = g;
+        }
+        if (groups[largest].size() < 2) {
+            break;
+        }
+        const size_t half = groups[largest].size() / 2;
+        groups.push_back(vector<size_t>(groups[largest].begin() + half, groups[largest].end()));
+        groups[largest].resize(half);
+    }
+
+    // Workers pull the next group until none are left
+    atomic<size_t> next(0);
+    atomic<size_t> done(0);
+
+    // Keep the pipelines quiet, progress goes to stderr
+    QuietConsole quiet;
+
+    vector<thread> workers;
+    const int count = std::max(1, std::min(threads, (int)groups.size()));
+    for (int w = 0; w < count; w++) {
+        workers.push_back(thread([&]() {
+            for (size_t i = next++; i < groups.size(); i = next++) {
+                evaluate(configs, groups[i], truthBpm, results);
+                done += groups[i].size();
+                cerr << "Sweep " << done << "/" << configs.size() << "\r";
+            }
+        }));
+    }
+    for (size_t w = 0; w < workers.size(); w++) {
+        workers[w].join();
+    }
+
+    cerr << endl;
+}
+
+bool ParameterSweep::write(const string &path, const vector<SweepConfig> &configs,
+                           const vector<SweepResult> &results) {
+
+    ofstream table(path.c_str());
+    if (!table.is_open()) {
+        return false;
+    }
+
+    table << "rppg;filter;pca;estimator;min;max;f;hop;resample;quality;"
+          << "estimates;mean;sd;min_bpm;max_bpm;mae;rmse;bias;seconds\n";
+
+    for (size_t i = 0; i < configs.size(); i++) {
+        const SweepConfig &c = configs[i];
+        const SweepResult &r = results[i];
+        table << RPPG_NAMES[c.rPPGAlg] << ";" << BANDPASS_NAMES[c.bandpassAlg] << ";"
+              << PCA_NAMES[c.pcaAlg] << ";" << ESTIMATOR_NAMES[c.estimatorAlg] << ";"
+              << c.minSignalSize << ";" << c.maxSignalSize << ";"
+              << c.samplingFrequency << ";" << c.estimationHop << ";"
+              << c.resampleRate << ";" << c.quality << ";"
+              << r.estimates << ";" << r.meanBpm << ";" << r.sdBpm << ";"
+              << r.minBpm << ";" << r.maxBpm << ";" << r.mae << ";" << r.rmse << ";" << r.bias << ";"
+              << r.seconds << "\n";
+    }
+
+    return table.good();
+}
@@ -0,0 +1,85 @@
+//
+//  Sweep.hpp
+//  Heartbeat
+//
+//  Created by Philipp Rouast on 19/10/2026.
+//  Copyright © 2026 Philipp Roüast. All rights reserved.
+//
+
+#ifndef Sweep_hpp
+#define Sweep_hpp
+
+#include <string>
+#include <vector>
+
+#include "RPPG.hpp"
+#include "Trace.hpp"
+
+#include <stdio.h>
+
+/* PARAMETER SWEEP
+ *
+ * Evaluates many settings on one recorded trace. The trace is read once
+ * and shared read-only. Configurations with the same window settings see
+ * identical windows, so they are grouped and run in lockstep on one worker,
+ * denoising and normalizing each window once for the group. Groups run in
+ * parallel and share the designed bandpass filters through the filter
+ * cache. */
+
+struct SweepConfig {
+    rPPGAlgorithm rPPGAlg;
+    bandpassAlgorithm bandpassAlg;
+    pcaAlgorithm pcaAlg;
+    estimatorAlgorithm estimatorAlg;
+    int minSignalSize;
+    int maxSignalSize;
+    double samplingFrequency;
+    double estimationHop;
+    double resampleRate;
+    bool quality;
+};
+
+struct SweepResult {
+    int estimates;
+    double meanBpm;
+    double sdBpm;
+    double minBpm;
+    double maxBpm;
+    double mae;     // against the ground truth, NaN without one
+    double rmse;
+    double bias;
+    double seconds;
+};
+
+class ParameterSweep {
+
+public:
+
+    ParameterSweep() {;}
+
+    // Load the trace to sweep over; replay needs no face detector
+    bool load(const std::string &tracePath);
+
+    // Run all configurations on up to threads workers; truthBpm > 0 scores
+    // the sampled heart rates against it
+    void run(const std::vector<SweepConfig> &configs, int threads, double truthBpm,
+             std::vector<SweepResult> &results);
+
+    // Consolidated table with one row per configuration
+    static bool write(const std::string &path, const std::vector<SweepConfig> &configs,
+                      const std::vector<SweepResult> &results);
+
+private:
+
+    // Configurations whose windows only depend on these settings
+    static bool sameWindows(const SweepConfig &a, const SweepConfig &b);
+
+    // Run a group of configurations with the same windows side by side
+    void evaluate(const std::vector<SweepConfig> &configs, const std::vector<size_t> &group,
+                  double truthBpm, std::vector<SweepResult> &results) const;
+
+    std::vector<TraceSample> samples;
+    double timeBase;
+};
+
+#endif /* Sweep_hpp */
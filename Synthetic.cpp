@@ -0,0 +1,197 @@
+//
+//  Synthetic.cpp
+//  Heartbeat
+//
+//  Created by Philipp Rouast on 19/10/2026.
+//  Copyright © 2026 Philipp Roüast. All rights reserved.
+//
+
+#include "Synthetic.hpp"
+
+#include <opencv2/imgproc.hpp>
+
+using namespace cv;
+using namespace std;
+
+#define FACE_SIZE 0.95 // relative to the smaller frame dimension, detections must exceed 0.4
+#define TEXTURE_SCALE 0.02 // relative to the face size
+#define LIGHTING_PERIOD 20 // seconds
+#define SWAY_FREQUENCY_X 0.25 // Hz
+#define SWAY_FREQUENCY_Y 0.17 // Hz
+#define PULSE_CYCLE_SAMPLES 1000
+
+// Relative pulsatile strength of the skin per channel in BGR
+static const double PULSE_SIGNATURE[] = {0.69, 1.0, 0.43};
+
+// Smooth random texture of the given size in [-1, 1]
+static Mat1f texture(RNG &rng, Size size, double scale) {
+    Mat1f t(size);
+    rng.fill(t, RNG::UNIFORM, -1, 1);
+    const int k = 2 * max((int)(scale * min(size.width, size.height)), 1) + 1;
+    GaussianBlur(t, t, Size(k, k), 0);
+    normalize(t, t, -1, 1, NORM_MINMAX);
+    return t;
+}
+
+void SyntheticVideo::load(const int width, const int height, const double fps, const double duration,
+                          const double bpm, const pulseWaveform waveform,
+                          const double amplitude, const double motion,
+                          const double noise, const double drift,
+                          const uint64_t seed) {
+
+    this->width = width;
+    this->height = height;
+    this->fps = fps;
+    this->bpm = bpm;
+    this->waveform = waveform;
+    this->amplitude = amplitude;
+    this->motion = motion;
+    this->noise = noise;
+    this->drift = drift;
+    this->frameCount = (int)(duration * fps);
+    this->seed = seed;
+
+    // Zero mean of the pulse over one cycle
+    this->pulseMean = 0;
+    if (waveform == physiological) {
+        double sum = 0;
+        for (int i = 0; i < PULSE_CYCLE_SAMPLES; i++) {
+            sum += pulse(i / (bpm / 60.0) / PULSE_CYCLE_SAMPLES);
+        }
+        this->pulseMean = sum / PULSE_CYCLE_SAMPLES;
+    }
+
+    RNG layers(seed);
+
+    // Background: horizontal gradient with a coarse texture
+    background.create(height, width);
+    Mat1f bgTexture = texture(layers, Size(width, height), 2 * TEXTURE_SCALE);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            const float v = 90 + 60.0f * x / width + 15 * bgTexture(y, x);
+            background(y, x) = Vec3f(v + 10, v, v - 10);
+        }
+    }
+
+    // Face sprite
+    const int size = max((int)(FACE_SIZE * min(width, height)), 16);
+    const Point c(size / 2, size / 2);
+    face.create(size, size);
+    face.setTo(Scalar(0, 0, 0));
+    faceMask = Mat1b::zeros(size, size);
+    skinMask = Mat1b::zeros(size, size);
+
+    // Hair behind the top of the head
+    const Size head(cvRound(0.31 * size), cvRound(0.46 * size));
+    ellipse(face, c, Size(head.width + size / 40, head.height), 0, 180, 360, Scalar(35, 40, 50), FILLED);
+    ellipse(faceMask, c, Size(head.width + size / 40, head.height), 0, 180, 360, Scalar(255), FILLED);
+
+    // Skin with a fine texture
+    const Point skinCenter(c.x, c.y + cvRound(0.03 * size));
+    Mat1b skin = Mat1b::zeros(size, size);
+    ellipse(skin, skinCenter, head, 0, 0, 360, Scalar(255), FILLED);
+    Mat1f skinTexture = texture(layers, Size(size, size), TEXTURE_SCALE);
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            if (skin(y, x)) {
+                const float shade = 1 + 0.05f * skinTexture(y, x);
+                face(y, x) = Vec3f(110 * shade, 140 * shade, 190 * shade);
+            }
+        }
+    }
+    faceMask.setTo(255, skin);
+    skin.copyTo(skinMask);
+
+    // Features, excluded from the pulsatile skin
+    const int eyeY = cvRound(0.42 * size);
+    const int eyeDX = cvRound(0.13 * size);
+    const Size eye(cvRound(0.06 * size), cvRound(0.028 * size));
+    const int thick = max(size / 50, 1);
+    for (int side = -1; side <= 1; side += 2) {
+        const Point eyeCenter(c.x + side * eyeDX, eyeY);
+        const Point browCenter(eyeCenter.x, cvRound(0.36 * size));
+        ellipse(face, browCenter, Size(eye.width + thick, eye.height), 0, 200, 340, Scalar(40, 50, 70), 2 * thick);
+        ellipse(skinMask, browCenter, Size(eye.width + thick, eye.height), 0, 200, 340, Scalar(0), 2 * thick);
+        ellipse(face, eyeCenter, eye, 0, 0, 360, Scalar(225, 225, 225), FILLED);
+        circle(face, eyeCenter, max(eye.height - 1, 1), Scalar(40, 30, 20), FILLED);
+        ellipse(skinMask, eyeCenter, eye, 0, 0, 360, Scalar(0), FILLED);
+    }
+
+    // Nose shadow and mouth
+    Point nose[] = {Point(c.x, cvRound(0.45 * size)),
+                    Point(cvRound(c.x - 0.04 * size), cvRound(0.6 * size)),
+                    Point(cvRound(c.x + 0.04 * size), cvRound(0.6 * size))};
+    fillConvexPoly(face, nose, 3, Scalar(90, 115, 165));
+    const Point mouthCenter(c.x, cvRound(0.72 * size));
+    const Size mouth(cvRound(0.1 * size), cvRound(0.03 * size));
+    ellipse(face, mouthCenter, mouth, 0, 0, 360, Scalar(70, 75, 150), FILLED);
+    ellipse(skinMask, mouthCenter, mouth, 0, 0, 360, Scalar(0), FILLED);
+
+    canvas.create(height, width);
+    grain.create(height, width);
+
+    rewind();
+}
+
+void SyntheticVideo::rewind() {
+    index = 0;
+    rng = RNG(seed + 1);
+}
+
+// Pulse at time t in seconds, zero mean with unit amplitude
+double SyntheticVideo::pulse(double t) const {
+
+    const double cycles = t * bpm / 60.0;
+
+    if (waveform == sine) {
+        return sin(2 * CV_PI * cycles);
+    }
+
+    // Systolic peak and dicrotic wave as two Gaussians per beat
+    const double x = cycles - floor(cycles);
+    const double systolic = (x - 0.2) / 0.07;
+    const double dicrotic = (x - 0.5) / 0.09;
+    return 2 * (exp(-0.5 * systolic * systolic) + 0.45 * exp(-0.5 * dicrotic * dicrotic) - pulseMean);
+}
+
+bool SyntheticVideo::read(Mat &frame, int64_t &time) {
+
+    if (index >= frameCount) {
+        return false;
+    }
+
+    const double t = index / fps;
+    time = (int64_t)cvRound(1000 * t);
+
+    background.copyTo(canvas);
+
+    // Swaying face, clipped to the frame
+    const int dx = cvRound(motion * sin(2 * CV_PI * SWAY_FREQUENCY_X * t));
+    const int dy = cvRound(0.5 * motion * sin(2 * CV_PI * SWAY_FREQUENCY_Y * t + 1));
+    const Rect placed((width - face.cols) / 2 + dx, (height - face.rows) / 2 + dy, face.cols, face.rows);
+    const Rect target = placed & Rect(0, 0, width, height);
+    if (target.area() > 0) {
+        const Rect source = target - placed.tl();
+        Mat3f roi = canvas(target);
+        face(source).copyTo(roi, faceMask(source));
+
+        const double p = amplitude * pulse(t);
+        add(roi, Scalar(p * PULSE_SIGNATURE[0], p * PULSE_SIGNATURE[1], p * PULSE_SIGNATURE[2]), roi, skinMask(source));
+    }
+
+    // Slow lighting drift
+    if (drift > 0) {
+        canvas *= 1 + drift * sin(2 * CV_PI * t / LIGHTING_PERIOD);
+    }
+
+    // Sensor noise
+    if (noise > 0) {
+        rng.fill(grain, RNG::NORMAL, 0, noise);
+        canvas += grain;
+    }
+
+    canvas.convertTo(frame, CV_8UC3);
+
+    index++;
+    return true;
+}
@@ -0,0 +1,84 @@
+//
+//  Synthetic.hpp
+//  Heartbeat
+//
+//  Created by Philipp Rouast on 19/10/2026.
+//  Copyright © 2026 Philipp Roüast. All rights reserved.
+//
+
+#ifndef Synthetic_hpp
+#define Synthetic_hpp
+
+#include <stdint.h>
+#include <opencv2/core.hpp>
+
+#include <stdio.h>
+
+enum pulseWaveform { sine, physiological };
+
+/* SYNTHETIC VIDEO
+ *
+ * Renders a face-like textured patch on a textured background whose skin is
+ * modulated by a pulse of known rate. The face sways, the lighting drifts
+ * slowly and sensor noise is added per frame, so the whole pipeline from
+ * face detection to estimation runs against a known ground truth. */
+
+class SyntheticVideo {
+
+public:
+
+    // Constructor
+    SyntheticVideo() {;}
+
+    // Load settings; amplitude and noise are in intensity levels, motion in
+    // pixels and drift is the relative amplitude of the lighting change
+    void load(const int width, const int height, const double fps, const double duration,
+              const double bpm, const pulseWaveform waveform = sine,
+              const double amplitude = 1, const double motion = 0,
+              const double noise = 0, const double drift = 0,
+              const uint64_t seed = 0x5eed);
+
+    // Render the next frame and its time in ms; false at the end
+    bool read(cv::Mat &frame, int64_t &time);
+
+    // Restart from the first frame
+    void rewind();
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    double getBpm() const { return bpm; }
+    double getFps() const { return fps; }
+    int getFrameCount() const { return frameCount; }
+
+private:
+
+    double pulse(double t) const;
+
+    // Settings
+    int width;
+    int height;
+    double fps;
+    double bpm;
+    pulseWaveform waveform;
+    double amplitude;
+    double motion;
+    double noise;
+    double drift;
+    int frameCount;
+    double pulseMean;
+
+    // State
+    int index;
+    cv::RNG rng;
+    uint64_t seed;
+
+    // Prerendered layers
+    cv::Mat3f background;
+    cv::Mat3f face;
+    cv::Mat1b faceMask;
+    cv::Mat1b skinMask;
+    cv::Mat3f canvas;
+    cv::Mat3f grain;
+};
+
+#endif /* Synthetic_hpp */
@@ -0,0 +1,81 @@
+//
+//  Trace.cpp
+//  Heartbeat
+//
+//  Created by Philipp Rouast on 19/10/2026.
+//  Copyright © 2026 Philipp Roüast. All rights reserved.
+//
+
+#include "Trace.hpp"
+
+#include <string.h>
+
+#define TRACE_MAGIC "HBTR"
+#define TRACE_VERSION 1
+#define TRACE_RECORD_SIZE 25 // time, 3 values, motion, flags
+
+enum { TRACE_FACE_VALID = 1, TRACE_RESCAN = 2, TRACE_SATURATED = 4 };
+
+using namespace std;
+
+bool TraceWriter::open(const string &path, double timeBase) {
+
+    file.open(path.c_str(), ios::binary | ios::trunc);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    const uint32_t version = TRACE_VERSION;
+    file.write(TRACE_MAGIC, 4);
+    file.write((const char *)&version, sizeof(version));
+    file.write((const char *)&timeBase, sizeof(timeBase));
+    return file.good();
+}
+
+void TraceWriter::write(const TraceSample &sample) {
+
+    // Packed, so the record size does not depend on struct padding
+    char record[TRACE_RECORD_SIZE];
+    memcpy(record, &sample.time, 8);
+    memcpy(record + 8, sample.values, 12);
+    memcpy(record + 20, &sample.motion, 4);
+    record[24] = (sample.faceValid ? TRACE_FACE_VALID : 0) |
+                 (sample.rescan ? TRACE_RESCAN : 0) |
+                 (sample.saturated ? TRACE_SATURATED : 0);
+    file.write(record, TRACE_RECORD_SIZE);
+}
+
+void TraceWriter::close() {
+    file.close();
+}
+
+bool TraceReader::open(const string &path) {
+
+    file.open(path.c_str(), ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    char magic[4];
+    uint32_t version = 0;
+    file.read(magic, 4);
+    file.read((char *)&version, sizeof(version));
+    file.read((char *)&timeBase, sizeof(timeBase));
+    return file.good() && memcmp(magic, TRACE_MAGIC, 4) == 0 && version == TRACE_VERSION;
+}
+
+bool TraceReader::read(TraceSample &sample) {
+
+    char record[TRACE_RECORD_SIZE];
+    if (!file.read(record, TRACE_RECORD_SIZE)) {
+        return false;
+    }
+
+    memcpy(&sample.time, record, 8);
+    memcpy(sample.values, record + 8, 12);
+    memcpy(&sample.motion, record + 20, 4);
+    sample.faceValid = (record[24] & TRACE_FACE_VALID) != 0;
+    sample.rescan = (record[24] & TRACE_RESCAN) != 0;
+    sample.saturated = (record[24] & TRACE_SATURATED) != 0;
+    return true;
+}
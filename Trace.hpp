@@ -0,0 +1,66 @@
+//
+//  Trace.hpp
+//  Heartbeat
+//
+//  Created by Philipp Rouast on 19/10/2026.
+//  Copyright © 2026 Philipp Roüast. All rights reserved.
+//
+
+#ifndef Trace_hpp
+#define Trace_hpp
+
+#include <stdint.h>
+#include <fstream>
+#include <string>
+
+#include <stdio.h>
+
+/* SAMPLE TRACES
+ *
+ * Binary record of the per-frame ROI samples, so the signal side can be
+ * rerun without decoding video or detecting faces. The file starts with the
+ * magic "HBTR", a uint32 version and the double time base, followed by one
+ * fixed-size record per frame in host byte order. */
+
+struct TraceSample {
+    int64_t time;
+    float values[3];  // ROI means in BGR, zero without a face
+    float motion;     // tracked face motion relative to the face width
+    bool faceValid;
+    bool rescan;
+    bool saturated;
+};
+
+class TraceWriter {
+
+public:
+
+    TraceWriter() {;}
+
+    bool open(const std::string &path, double timeBase);
+    void write(const TraceSample &sample);
+    void close();
+    bool isOpen() const { return file.is_open(); }
+
+private:
+
+    std::ofstream file;
+};
+
+class TraceReader {
+
+public:
+
+    TraceReader() {;}
+
+    bool open(const std::string &path);
+    bool read(TraceSample &sample);
+    double getTimeBase() const { return timeBase; }
+
+private:
+
+    std::ifstream file;
+    double timeBase;
+};
+
+#endif /* Trace_hpp */
@@ -0,0 +1,799 @@
+//
+//  dsp.cpp
+//  Heartbeat
+//
+//  Created by Philipp Rouast on 19/10/2026.
+//  Copyright © 2026 Philipp Roüast. All rights reserved.
+//
+
+#include "dsp.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define DSP_X86 1
+#include <immintrin.h>
+#define DSP_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace cv {
+
+    namespace dsp {
+
+        // Same as cv::borderInterpolate with BORDER_REFLECT_101
+        static inline int reflect101(int p, int n) {
+            if (n == 1) return 0;
+            while (p < 0 || p >= n) {
+                p = p < 0 ? -p : 2 * n - 2 - p;
+            }
+            return p;
+        }
+
+        // Extend a by the border needed for a box filter of size s
+        static const float *extend(const float *a, int n, int s) {
+            static thread_local std::vector<float> ext;
+            const int anchor = s / 2;
+            ext.resize(n + s - 1);
+            for (int k = 0; k < anchor && k < n + s - 1; k++) {
+                ext[k] = a[reflect101(k - anchor, n)];
+            }
+            for (int i = 0; i < n; i++) {
+                ext[i + anchor] = a[i];
+            }
+            for (int k = n + anchor; k < n + s - 1; k++) {
+                ext[k] = a[reflect101(k - anchor, n)];
+            }
+            return ext.data();
+        }
+
+        // Next index > i with a jump, or n
+        static inline int nextJump(const unsigned char *jumps, int i, int n) {
+            while (i < n && !jumps[i]) i++;
+            return i;
+        }
+
+        // Source index of every sample of a lane extended for a box filter of size s
+        static const int *extendIndex(int n, int s) {
+            static thread_local std::vector<int> index;
+            const int anchor = s / 2;
+            index.resize(n + s - 1);
+            for (int k = 0; k < n + s - 1; k++) {
+                index[k] = reflect101(k - anchor, n);
+            }
+            return index.data();
+        }
+
+        /* SCALAR */
+
+        namespace scalar {
+
+            static void meanStdDev(const float *a, int n, double &mean, double &stdDev) {
+                double sum = 0;
+                for (int i = 0; i < n; i++) sum += a[i];
+                mean = n > 0 ? sum / n : 0;
+                double sq = 0;
+                for (int i = 0; i < n; i++) sq += (a[i] - mean) * (a[i] - mean);
+                stdDev = n > 0 ? std::sqrt(sq / n) : 0;
+            }
+
+            static void normalize(const float *a, float *b, int n) {
+                double mean, stdDev;
+                meanStdDev(a, n, mean, stdDev);
+                const float m = (float)mean, sd = (float)stdDev;
+                for (int i = 0; i < n; i++) b[i] = (a[i] - m) / sd;
+            }
+
+            static void subtract(const float *a, float v, float *b, int n) {
+                for (int i = 0; i < n; i++) b[i] = a[i] - v;
+            }
+
+            static void weightedSum(const float *a, float wa, const float *b, float wb, float *c, int n) {
+                for (int i = 0; i < n; i++) c[i] = wa * a[i] + wb * b[i];
+            }
+
+            static void magnitude(const float *complex, float *mag, int n) {
+                for (int i = 0; i < n; i++) {
+                    const float re = complex[2*i], im = complex[2*i+1];
+                    mag[i] = std::sqrt(re * re + im * im);
+                }
+            }
+
+            static void removeJumpsLanes(float *a, const unsigned char *jumps, int n, int lanes) {
+                for (int k = 0; k < lanes; k++) {
+                    float offset = 0, prev = a[k];
+                    for (int i = 1; i < n; i++) {
+                        const float v = a[i * lanes + k];
+                        if (jumps[i * lanes + k]) offset += v - prev;
+                        a[i * lanes + k] = v - offset;
+                        prev = v;
+                    }
+                }
+            }
+
+            static void normalizeLanes(float *a, int n, int lanes) {
+                for (int k = 0; k < lanes; k++) {
+                    double sum = 0;
+                    for (int i = 0; i < n; i++) sum += a[i * lanes + k];
+                    const double mean = sum / n;
+                    double sq = 0;
+                    for (int i = 0; i < n; i++) sq += (a[i * lanes + k] - mean) * (a[i * lanes + k] - mean);
+                    const float m = (float)mean, sd = (float)std::sqrt(sq / n);
+                    for (int i = 0; i < n; i++) a[i * lanes + k] = (a[i * lanes + k] - m) / sd;
+                }
+            }
+
+            static void detrendLanes(float *a, int n, int lanes, const double *diag, const double *l1, const double *l2) {
+                static thread_local std::vector<double> x;
+                x.resize(n);
+                for (int k = 0; k < lanes; k++) {
+                    for (int i = 0; i < n; i++) {
+                        x[i] = a[i * lanes + k];
+                        if (i >= 1) x[i] -= l1[i] * x[i-1];
+                        if (i >= 2) x[i] -= l2[i] * x[i-2];
+                    }
+                    for (int i = n - 1; i >= 0; i--) {
+                        x[i] /= diag[i];
+                        if (i + 1 < n) x[i] -= l1[i+1] * x[i+1];
+                        if (i + 2 < n) x[i] -= l2[i+2] * x[i+2];
+                        a[i * lanes + k] = (float)(a[i * lanes + k] - x[i]);
+                    }
+                }
+            }
+
+            static void boxFilterLanes(float *a, int n, int lanes, int s) {
+                static thread_local std::vector<float> col;
+                col.resize(n);
+                for (int k = 0; k < lanes; k++) {
+                    for (int i = 0; i < n; i++) col[i] = a[i * lanes + k];
+                    boxFilter(col.data(), col.data(), n, s);
+                    for (int i = 0; i < n; i++) a[i * lanes + k] = col[i];
+                }
+            }
+
+            static void bandMagnitudeLanes(const float *a, int n, int lanes, int low, int high,
+                                           const float *cosines, const float *sines, float *mag) {
+                for (int k = 0; k < lanes; k++) {
+                    for (int bin = low; bin <= high; bin++) {
+                        float re = 0, im = 0;
+                        for (int i = 0, p = 0; i < n; i++, p = p + bin < n ? p + bin : p + bin - n) {
+                            re += a[i * lanes + k] * cosines[p];
+                            im += a[i * lanes + k] * sines[p];
+                        }
+                        mag[(bin - low) * lanes + k] = std::sqrt(re * re + im * im);
+                    }
+                }
+            }
+        }
+
+#ifdef DSP_X86
+
+        /* SSE2 */
+
+        namespace sse2 {
+
+            static void meanStdDev(const float *a, int n, double &mean, double &stdDev) {
+                __m128d acc0 = _mm_setzero_pd(), acc1 = _mm_setzero_pd();
+                int i = 0;
+                for (; i + 4 <= n; i += 4) {
+                    __m128 v = _mm_loadu_ps(a + i);
+                    acc0 = _mm_add_pd(acc0, _mm_cvtps_pd(v));
+                    acc1 = _mm_add_pd(acc1, _mm_cvtps_pd(_mm_movehl_ps(v, v)));
+                }
+                double buf[2];
+                _mm_storeu_pd(buf, _mm_add_pd(acc0, acc1));
+                double sum = buf[0] + buf[1];
+                for (; i < n; i++) sum += a[i];
+                mean = n > 0 ? sum / n : 0;
+
+                const __m128d m = _mm_set1_pd(mean);
+                acc0 = _mm_setzero_pd(); acc1 = _mm_setzero_pd();
+                for (i = 0; i + 4 <= n; i += 4) {
+                    __m128 v = _mm_loadu_ps(a + i);
+                    __m128d d0 = _mm_sub_pd(_mm_cvtps_pd(v), m);
+                    __m128d d1 = _mm_sub_pd(_mm_cvtps_pd(_mm_movehl_ps(v, v)), m);
+                    acc0 = _mm_add_pd(acc0, _mm_mul_pd(d0, d0));
+                    acc1 = _mm_add_pd(acc1, _mm_mul_pd(d1, d1));
+                }
+                _mm_storeu_pd(buf, _mm_add_pd(acc0, acc1));
+                double sq = buf[0] + buf[1];
+                for (; i < n; i++) sq += (a[i] - mean) * (a[i] - mean);
+                stdDev = n > 0 ? std::sqrt(sq / n) : 0;
+            }
+
+            static void normalize(const float *a, float *b, int n) {
+                double mean, stdDev;
+                meanStdDev(a, n, mean, stdDev);
+                const float m = (float)mean, sd = (float)stdDev;
+                const __m128 vm = _mm_set1_ps(m), vsd = _mm_set1_ps(sd);
+                int i = 0;
+                for (; i + 4 <= n; i += 4) {
+                    _mm_storeu_ps(b + i, _mm_div_ps(_mm_sub_ps(_mm_loadu_ps(a + i), vm), vsd));
+                }
+                for (; i < n; i++) b[i] = (a[i] - m) / sd;
+            }
+
+            static void subtract(const float *a, float v, float *b, int n) {
+                const __m128 vv = _mm_set1_ps(v);
+                int i = 0;
+                for (; i + 4 <= n; i += 4) {
+                    _mm_storeu_ps(b + i, _mm_sub_ps(_mm_loadu_ps(a + i), vv));
+                }
+                for (; i < n; i++) b[i] = a[i] - v;
+            }
+
+            static void weightedSum(const float *a, float wa, const float *b, float wb, float *c, int n) {
+                const __m128 vwa = _mm_set1_ps(wa), vwb = _mm_set1_ps(wb);
+                int i = 0;
+                for (; i + 4 <= n; i += 4) {
+                    _mm_storeu_ps(c + i, _mm_add_ps(_mm_mul_ps(vwa, _mm_loadu_ps(a + i)),
+                                                    _mm_mul_ps(vwb, _mm_loadu_ps(b + i))));
+                }
+                for (; i < n; i++) c[i] = wa * a[i] + wb * b[i];
+            }
+
+            static void magnitude(const float *complex, float *mag, int n) {
+                int i = 0;
+                for (; i + 4 <= n; i += 4) {
+                    __m128 v0 = _mm_loadu_ps(complex + 2*i);
+                    __m128 v1 = _mm_loadu_ps(complex + 2*i + 4);
+                    __m128 re = _mm_shuffle_ps(v0, v1, _MM_SHUFFLE(2, 0, 2, 0));
+                    __m128 im = _mm_shuffle_ps(v0, v1, _MM_SHUFFLE(3, 1, 3, 1));
+                    _mm_storeu_ps(mag + i, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(re, re), _mm_mul_ps(im, im))));
+                }
+                scalar::magnitude(complex + 2*i, mag + i, n - i);
+            }
+
+            // Jump flags of four lanes as an all-ones mask
+            static inline __m128 jumpMask(const unsigned char *jumps) {
+                int bits;
+                memcpy(&bits, jumps, sizeof(bits));
+                const __m128i zero = _mm_setzero_si128();
+                __m128i j = _mm_unpacklo_epi8(_mm_cvtsi32_si128(bits), zero);
+                j = _mm_unpacklo_epi16(j, zero);
+                return _mm_castsi128_ps(_mm_cmpgt_epi32(j, zero));
+            }
+
+            static void removeJumpsLanes(float *a, const unsigned char *jumps, int n, int lanes) {
+                for (int k = 0; k < lanes; k += 4) {
+                    __m128 offset = _mm_setzero_ps(), prev = _mm_loadu_ps(a + k);
+                    for (int i = 1; i < n; i++) {
+                        const __m128 v = _mm_loadu_ps(a + i * lanes + k);
+                        offset = _mm_add_ps(offset, _mm_and_ps(jumpMask(jumps + i * lanes + k), _mm_sub_ps(v, prev)));
+                        _mm_storeu_ps(a + i * lanes + k, _mm_sub_ps(v, offset));
+                        prev = v;
+                    }
+                }
+            }
+
+            static void normalizeLanes(float *a, int n, int lanes) {
+                const __m128d count = _mm_set1_pd(n);
+                for (int k = 0; k < lanes; k += 4) {
+                    __m128d sum0 = _mm_setzero_pd(), sum1 = _mm_setzero_pd();
+                    for (int i = 0; i < n; i++) {
+                        const __m128 v = _mm_loadu_ps(a + i * lanes + k);
+                        sum0 = _mm_add_pd(sum0, _mm_cvtps_pd(v));
+                        sum1 = _mm_add_pd(sum1, _mm_cvtps_pd(_mm_movehl_ps(v, v)));
+                    }
+                    const __m128d m0 = _mm_div_pd(sum0, count), m1 = _mm_div_pd(sum1, count);
+                    __m128d sq0 = _mm_setzero_pd(), sq1 = _mm_setzero_pd();
+                    for (int i = 0; i < n; i++) {
+                        const __m128 v = _mm_loadu_ps(a + i * lanes + k);
+                        const __m128d d0 = _mm_sub_pd(_mm_cvtps_pd(v), m0);
+                        const __m128d d1 = _mm_sub_pd(_mm_cvtps_pd(_mm_movehl_ps(v, v)), m1);
+                        sq0 = _mm_add_pd(sq0, _mm_mul_pd(d0, d0));
+                        sq1 = _mm_add_pd(sq1, _mm_mul_pd(d1, d1));
+                    }
+                    const __m128 m = _mm_movelh_ps(_mm_cvtpd_ps(m0), _mm_cvtpd_ps(m1));
+                    const __m128 sd = _mm_movelh_ps(_mm_cvtpd_ps(_mm_sqrt_pd(_mm_div_pd(sq0, count))),
+                                                    _mm_cvtpd_ps(_mm_sqrt_pd(_mm_div_pd(sq1, count))));
+                    for (int i = 0; i < n; i++) {
+                        float *p = a + i * lanes + k;
+                        _mm_storeu_ps(p, _mm_div_ps(_mm_sub_ps(_mm_loadu_ps(p), m), sd));
+                    }
+                }
+            }
+
+            static void detrendLanes(float *a, int n, int lanes, const double *diag, const double *l1, const double *l2) {
+                static thread_local std::vector<double> x;
+                x.resize(4 * n);
+                double *xp = x.data();
+                for (int k = 0; k < lanes; k += 4) {
+                    for (int i = 0; i < n; i++) {
+                        const __m128 v = _mm_loadu_ps(a + i * lanes + k);
+                        __m128d x0 = _mm_cvtps_pd(v), x1 = _mm_cvtps_pd(_mm_movehl_ps(v, v));
+                        if (i >= 1) {
+                            const __m128d l = _mm_set1_pd(l1[i]);
+                            x0 = _mm_sub_pd(x0, _mm_mul_pd(l, _mm_loadu_pd(xp + 4 * (i-1))));
+                            x1 = _mm_sub_pd(x1, _mm_mul_pd(l, _mm_loadu_pd(xp + 4 * (i-1) + 2)));
+                        }
+                        if (i >= 2) {
+                            const __m128d l = _mm_set1_pd(l2[i]);
+                            x0 = _mm_sub_pd(x0, _mm_mul_pd(l, _mm_loadu_pd(xp + 4 * (i-2))));
+                            x1 = _mm_sub_pd(x1, _mm_mul_pd(l, _mm_loadu_pd(xp + 4 * (i-2) + 2)));
+                        }
+                        _mm_storeu_pd(xp + 4 * i, x0);
+                        _mm_storeu_pd(xp + 4 * i + 2, x1);
+                    }
+                    for (int i = n - 1; i >= 0; i--) {
+                        const __m128d d = _mm_set1_pd(diag[i]);
+                        __m128d x0 = _mm_div_pd(_mm_loadu_pd(xp + 4 * i), d);
+                        __m128d x1 = _mm_div_pd(_mm_loadu_pd(xp + 4 * i + 2), d);
+                        if (i + 1 < n) {
+                            const __m128d l = _mm_set1_pd(l1[i+1]);
+                            x0 = _mm_sub_pd(x0, _mm_mul_pd(l, _mm_loadu_pd(xp + 4 * (i+1))));
+                            x1 = _mm_sub_pd(x1, _mm_mul_pd(l, _mm_loadu_pd(xp + 4 * (i+1) + 2)));
+                        }
+                        if (i + 2 < n) {
+                            const __m128d l = _mm_set1_pd(l2[i+2]);
+                            x0 = _mm_sub_pd(x0, _mm_mul_pd(l, _mm_loadu_pd(xp + 4 * (i+2))));
+                            x1 = _mm_sub_pd(x1, _mm_mul_pd(l, _mm_loadu_pd(xp + 4 * (i+2) + 2)));
+                        }
+                        _mm_storeu_pd(xp + 4 * i, x0);
+                        _mm_storeu_pd(xp + 4 * i + 2, x1);
+                        float *p = a + i * lanes + k;
+                        const __m128 v = _mm_loadu_ps(p);
+                        _mm_storeu_ps(p, _mm_movelh_ps(_mm_cvtpd_ps(_mm_sub_pd(_mm_cvtps_pd(v), x0)),
+                                                       _mm_cvtpd_ps(_mm_sub_pd(_mm_cvtps_pd(_mm_movehl_ps(v, v)), x1))));
+                    }
+                }
+            }
+
+            static void boxFilterLanes(float *a, int n, int lanes, int s) {
+                static thread_local std::vector<float> block;
+                block.resize(4 * n);
+                const int *index = extendIndex(n, s);
+                const __m128d scale = _mm_set1_pd(1.0 / s);
+                for (int k = 0; k < lanes; k += 4) {
+                    for (int i = 0; i < n; i++) {
+                        _mm_storeu_ps(block.data() + 4 * i, _mm_loadu_ps(a + i * lanes + k));
+                    }
+                    __m128d sum0 = _mm_setzero_pd(), sum1 = _mm_setzero_pd();
+                    for (int j = 0; j < s - 1; j++) {
+                        const __m128 v = _mm_loadu_ps(block.data() + 4 * index[j]);
+                        sum0 = _mm_add_pd(sum0, _mm_cvtps_pd(v));
+                        sum1 = _mm_add_pd(sum1, _mm_cvtps_pd(_mm_movehl_ps(v, v)));
+                    }
+                    for (int i = 0; i < n; i++) {
+                        __m128 v = _mm_loadu_ps(block.data() + 4 * index[i + s - 1]);
+                        sum0 = _mm_add_pd(sum0, _mm_cvtps_pd(v));
+                        sum1 = _mm_add_pd(sum1, _mm_cvtps_pd(_mm_movehl_ps(v, v)));
+                        _mm_storeu_ps(a + i * lanes + k, _mm_movelh_ps(_mm_cvtpd_ps(_mm_mul_pd(sum0, scale)),
+                                                                       _mm_cvtpd_ps(_mm_mul_pd(sum1, scale))));
+                        v = _mm_loadu_ps(block.data() + 4 * index[i]);
+                        sum0 = _mm_sub_pd(sum0, _mm_cvtps_pd(v));
+                        sum1 = _mm_sub_pd(sum1, _mm_cvtps_pd(_mm_movehl_ps(v, v)));
+                    }
+                }
+            }
+
+            static void bandMagnitudeLanes(const float *a, int n, int lanes, int low, int high,
+                                           const float *cosines, const float *sines, float *mag) {
+                for (int k = 0; k < lanes; k += 4) {
+                    for (int bin = low; bin <= high; bin++) {
+                        __m128 re = _mm_setzero_ps(), im = _mm_setzero_ps();
+                        for (int i = 0, p = 0; i < n; i++, p = p + bin < n ? p + bin : p + bin - n) {
+                            const __m128 v = _mm_loadu_ps(a + i * lanes + k);
+                            re = _mm_add_ps(re, _mm_mul_ps(v, _mm_set1_ps(cosines[p])));
+                            im = _mm_add_ps(im, _mm_mul_ps(v, _mm_set1_ps(sines[p])));
+                        }
+                        _mm_storeu_ps(mag + (bin - low) * lanes + k,
+                                      _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(re, re), _mm_mul_ps(im, im))));
+                    }
+                }
+            }
+        }
+
+        /* AVX2 */
+
+        namespace avx2 {
+
+            DSP_AVX2 static inline double hsum(__m256d v) {
+                __m128d s = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+                return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+            }
+
+            DSP_AVX2 static void meanStdDev(const float *a, int n, double &mean, double &stdDev) {
+                __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+                int i = 0;
+                for (; i + 8 <= n; i += 8) {
+                    __m256 v = _mm256_loadu_ps(a + i);
+                    acc0 = _mm256_add_pd(acc0, _mm256_cvtps_pd(_mm256_castps256_ps128(v)));
+                    acc1 = _mm256_add_pd(acc1, _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1)));
+                }
+                double sum = hsum(_mm256_add_pd(acc0, acc1));
+                for (; i < n; i++) sum += a[i];
+                mean = n > 0 ? sum / n : 0;
+
+                const __m256d m = _mm256_set1_pd(mean);
+                acc0 = _mm256_setzero_pd(); acc1 = _mm256_setzero_pd();
+                for (i = 0; i + 8 <= n; i += 8) {
+                    __m256 v = _mm256_loadu_ps(a + i);
+                    __m256d d0 = _mm256_sub_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(v)), m);
+                    __m256d d1 = _mm256_sub_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(v, 1)), m);
+                    acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(d0, d0));
+                    acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(d1, d1));
+                }
+                double sq = hsum(_mm256_add_pd(acc0, acc1));
+                for (; i < n; i++) sq += (a[i] - mean) * (a[i] - mean);
+                stdDev = n > 0 ? std::sqrt(sq / n) : 0;
+            }
+
+            DSP_AVX2 static void normalize(const float *a, float *b, int n) {
+                double mean, stdDev;
+                meanStdDev(a, n, mean, stdDev);
+                const float m = (float)mean, sd = (float)stdDev;
+                const __m256 vm = _mm256_set1_ps(m), vsd = _mm256_set1_ps(sd);
+                int i = 0;
+                for (; i + 8 <= n; i += 8) {
+                    _mm256_storeu_ps(b + i, _mm256_div_ps(_mm256_sub_ps(_mm256_loadu_ps(a + i), vm), vsd));
+                }
+                for (; i < n; i++) b[i] = (a[i] - m) / sd;
+            }
+
+            DSP_AVX2 static void subtract(const float *a, float v, float *b, int n) {
+                const __m256 vv = _mm256_set1_ps(v);
+                int i = 0;
+                for (; i + 8 <= n; i += 8) {
+                    _mm256_storeu_ps(b + i, _mm256_sub_ps(_mm256_loadu_ps(a + i), vv));
+                }
+                for (; i < n; i++) b[i] = a[i] - v;
+            }
+
+            DSP_AVX2 static void weightedSum(const float *a, float wa, const float *b, float wb, float *c, int n) {
+                const __m256 vwa = _mm256_set1_ps(wa), vwb = _mm256_set1_ps(wb);
+                int i = 0;
+                for (; i + 8 <= n; i += 8) {
+                    _mm256_storeu_ps(c + i, _mm256_add_ps(_mm256_mul_ps(vwa, _mm256_loadu_ps(a + i)),
+                                                          _mm256_mul_ps(vwb, _mm256_loadu_ps(b + i))));
+                }
+                for (; i < n; i++) c[i] = wa * a[i] + wb * b[i];
+            }
+
+            DSP_AVX2 static void magnitude(const float *complex, float *mag, int n) {
+                int i = 0;
+                for (; i + 8 <= n; i += 8) {
+                    __m256 v0 = _mm256_loadu_ps(complex + 2*i);
+                    __m256 v1 = _mm256_loadu_ps(complex + 2*i + 8);
+                    // Lane-wise deinterleave yields the order 0 1 4 5 | 2 3 6 7
+                    __m256 re = _mm256_shuffle_ps(v0, v1, _MM_SHUFFLE(2, 0, 2, 0));
+                    __m256 im = _mm256_shuffle_ps(v0, v1, _MM_SHUFFLE(3, 1, 3, 1));
+                    __m256 m = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(re, re), _mm256_mul_ps(im, im)));
+                    m = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(m), _MM_SHUFFLE(3, 1, 2, 0)));
+                    _mm256_storeu_ps(mag + i, m);
+                }
+                sse2::magnitude(complex + 2*i, mag + i, n - i);
+            }
+
+            // Widen eight floats to two vectors of doubles and narrow them back
+            DSP_AVX2 static inline __m256d lower(__m256 v) { return _mm256_cvtps_pd(_mm256_castps256_ps128(v)); }
+            DSP_AVX2 static inline __m256d upper(__m256 v) { return _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1)); }
+            DSP_AVX2 static inline __m256 narrow(__m256d v0, __m256d v1) {
+                return _mm256_set_m128(_mm256_cvtpd_ps(v1), _mm256_cvtpd_ps(v0));
+            }
+
+            DSP_AVX2 static void removeJumpsLanes(float *a, const unsigned char *jumps, int n, int lanes) {
+                const __m256i zero = _mm256_setzero_si256();
+                for (int k = 0; k < lanes; k += 8) {
+                    __m256 offset = _mm256_setzero_ps(), prev = _mm256_loadu_ps(a + k);
+                    for (int i = 1; i < n; i++) {
+                        const __m256 v = _mm256_loadu_ps(a + i * lanes + k);
+                        const __m256i j = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(jumps + i * lanes + k)));
+                        const __m256 mask = _mm256_castsi256_ps(_mm256_cmpgt_epi32(j, zero));
+                        offset = _mm256_add_ps(offset, _mm256_and_ps(mask, _mm256_sub_ps(v, prev)));
+                        _mm256_storeu_ps(a + i * lanes + k, _mm256_sub_ps(v, offset));
+                        prev = v;
+                    }
+                }
+            }
+
+            DSP_AVX2 static void normalizeLanes(float *a, int n, int lanes) {
+                const __m256d count = _mm256_set1_pd(n);
+                for (int k = 0; k < lanes; k += 8) {
+                    __m256d sum0 = _mm256_setzero_pd(), sum1 = _mm256_setzero_pd();
+                    for (int i = 0; i < n; i++) {
+                        const __m256 v = _mm256_loadu_ps(a + i * lanes + k);
+                        sum0 = _mm256_add_pd(sum0, lower(v));
+                        sum1 = _mm256_add_pd(sum1, upper(v));
+                    }
+                    const __m256d m0 = _mm256_div_pd(sum0, count), m1 = _mm256_div_pd(sum1, count);
+                    __m256d sq0 = _mm256_setzero_pd(), sq1 = _mm256_setzero_pd();
+                    for (int i = 0; i < n; i++) {
+                        const __m256 v = _mm256_loadu_ps(a + i * lanes + k);
+                        const __m256d d0 = _mm256_sub_pd(lower(v), m0), d1 = _mm256_sub_pd(upper(v), m1);
+                        sq0 = _mm256_add_pd(sq0, _mm256_mul_pd(d0, d0));
+                        sq1 = _mm256_add_pd(sq1, _mm256_mul_pd(d1, d1));
+                    }
+                    const __m256 m = narrow(m0, m1);
+                    const __m256 sd = narrow(_mm256_sqrt_pd(_mm256_div_pd(sq0, count)), _mm256_sqrt_pd(_mm256_div_pd(sq1, count)));
+                    for (int i = 0; i < n; i++) {
+                        float *p = a + i * lanes + k;
+                        _mm256_storeu_ps(p, _mm256_div_ps(_mm256_sub_ps(_mm256_loadu_ps(p), m), sd));
+                    }
+                }
+            }
+
+            DSP_AVX2 static void detrendLanes(float *a, int n, int lanes, const double *diag, const double *l1, const double *l2) {
+                static thread_local std::vector<double> x;
+                x.resize(8 * n);
+                double *xp = x.data();
+                for (int k = 0; k < lanes; k += 8) {
+                    for (int i = 0; i < n; i++) {
+                        const __m256 v = _mm256_loadu_ps(a + i * lanes + k);
+                        __m256d x0 = lower(v), x1 = upper(v);
+                        if (i >= 1) {
+                            const __m256d l = _mm256_set1_pd(l1[i]);
+                            x0 = _mm256_sub_pd(x0, _mm256_mul_pd(l, _mm256_loadu_pd(xp + 8 * (i-1))));
+                            x1 = _mm256_sub_pd(x1, _mm256_mul_pd(l, _mm256_loadu_pd(xp + 8 * (i-1) + 4)));
+                        }
+                        if (i >= 2) {
+                            const __m256d l = _mm256_set1_pd(l2[i]);
+                            x0 = _mm256_sub_pd(x0, _mm256_mul_pd(l, _mm256_loadu_pd(xp + 8 * (i-2))));
+                            x1 = _mm256_sub_pd(x1, _mm256_mul_pd(l, _mm256_loadu_pd(xp + 8 * (i-2) + 4)));
+                        }
+                        _mm256_storeu_pd(xp + 8 * i, x0);
+                        _mm256_storeu_pd(xp + 8 * i + 4, x1);
+                    }
+                    for (int i = n - 1; i >= 0; i--) {
+                        const __m256d d = _mm256_set1_pd(diag[i]);
+                        __m256d x0 = _mm256_div_pd(_mm256_loadu_pd(xp + 8 * i), d);
+                        __m256d x1 = _mm256_div_pd(_mm256_loadu_pd(xp + 8 * i + 4), d);
+                        if (i + 1 < n) {
+                            const __m256d l = _mm256_set1_pd(l1[i+1]);
+                            x0 = _mm256_sub_pd(x0, _mm256_mul_pd(l, _mm256_loadu_pd(xp + 8 * (i+1))));
+                            x1 = _mm256_sub_pd(x1, _mm256_mul_pd(l, _mm256_loadu_pd(xp + 8 * (i+1) + 4)));
+                        }
+                        if (i + 2 < n) {
+                            const __m256d l = _mm256_set1_pd(l2[i+2]);
+                            x0 = _mm256_sub_pd(x0, _mm256_mul_pd(l, _mm256_loadu_pd(xp + 8 * (i+2))));
+                            x1 = _mm256_sub_pd(x1, _mm256_mul_pd(l, _mm256_loadu_pd(xp + 8 * (i+2) + 4)));
+                        }
+                        _mm256_storeu_pd(xp + 8 * i, x0);
+                        _mm256_storeu_pd(xp + 8 * i + 4, x1);
+                        float *p = a + i * lanes + k;
+                        const __m256 v = _mm256_loadu_ps(p);
+                        _mm256_storeu_ps(p, narrow(_mm256_sub_pd(lower(v), x0), _mm256_sub_pd(upper(v), x1)));
+                    }
+                }
+            }
+
+            DSP_AVX2 static void boxFilterLanes(float *a, int n, int lanes, int s) {
+                static thread_local std::vector<float> block;
+                block.resize(8 * n);
+                const int *index = extendIndex(n, s);
+                const __m256d scale = _mm256_set1_pd(1.0 / s);
+                for (int k = 0; k < lanes; k += 8) {
+                    for (int i = 0; i < n; i++) {
+                        _mm256_storeu_ps(block.data() + 8 * i, _mm256_loadu_ps(a + i * lanes + k));
+                    }
+                    __m256d sum0 = _mm256_setzero_pd(), sum1 = _mm256_setzero_pd();
+                    for (int j = 0; j < s - 1; j++) {
+                        const __m256 v = _mm256_loadu_ps(block.data() + 8 * index[j]);
+                        sum0 = _mm256_add_pd(sum0, lower(v));
+                        sum1 = _mm256_add_pd(sum1, upper(v));
+                    }
+                    for (int i = 0; i < n; i++) {
+                        __m256 v = _mm256_loadu_ps(block.data() + 8 * index[i + s - 1]);
+                        sum0 = _mm256_add_pd(sum0, lower(v));
+                        sum1 = _mm256_add_pd(sum1, upper(v));
+                        _mm256_storeu_ps(a + i * lanes + k, narrow(_mm256_mul_pd(sum0, scale), _mm256_mul_pd(sum1, scale)));
+                        v = _mm256_loadu_ps(block.data() + 8 * index[i]);
+                        sum0 = _mm256_sub_pd(sum0, lower(v));
+                        sum1 = _mm256_sub_pd(sum1, upper(v));
+                    }
+                }
+            }
+
+            DSP_AVX2 static void bandMagnitudeLanes(const float *a, int n, int lanes, int low, int high,
+                                                    const float *cosines, const float *sines, float *mag) {
+                for (int k = 0; k < lanes; k += 8) {
+                    for (int bin = low; bin <= high; bin++) {
+                        __m256 re = _mm256_setzero_ps(), im = _mm256_setzero_ps();
+                        for (int i = 0, p = 0; i < n; i++, p = p + bin < n ? p + bin : p + bin - n) {
+                            const __m256 v = _mm256_loadu_ps(a + i * lanes + k);
+                            re = _mm256_add_ps(re, _mm256_mul_ps(v, _mm256_set1_ps(cosines[p])));
+                            im = _mm256_add_ps(im, _mm256_mul_ps(v, _mm256_set1_ps(sines[p])));
+                        }
+                        _mm256_storeu_ps(mag + (bin - low) * lanes + k,
+                                         _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(re, re), _mm256_mul_ps(im, im))));
+                    }
+                }
+            }
+        }
+
+#endif
+
+        /* DISPATCH */
+
+        struct Kernels {
+            void (*meanStdDev)(const float *, int, double &, double &);
+            void (*normalize)(const float *, float *, int);
+            void (*subtract)(const float *, float, float *, int);
+            void (*weightedSum)(const float *, float, const float *, float, float *, int);
+            void (*magnitude)(const float *, float *, int);
+            void (*removeJumpsLanes)(float *, const unsigned char *, int, int);
+            void (*normalizeLanes)(float *, int, int);
+            void (*detrendLanes)(float *, int, int, const double *, const double *, const double *);
+            void (*boxFilterLanes)(float *, int, int, int);
+            void (*bandMagnitudeLanes)(const float *, int, int, int, int, const float *, const float *, float *);
+        };
+
+        static Isa detectIsa() {
+#ifdef DSP_X86
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx2")) return AVX2;
+            return SSE2;
+#else
+            return SCALAR;
+#endif
+        }
+
+        static const Isa maxIsa = detectIsa();
+        static Isa currentIsa = maxIsa;
+
+        static const Kernels &kernels() {
+            static const Kernels scalarKernels = {
+                scalar::meanStdDev, scalar::normalize, scalar::subtract,
+                scalar::weightedSum, scalar::magnitude,
+                scalar::removeJumpsLanes, scalar::normalizeLanes, scalar::detrendLanes,
+                scalar::boxFilterLanes, scalar::bandMagnitudeLanes
+            };
+#ifdef DSP_X86
+            static const Kernels sse2Kernels = {
+                sse2::meanStdDev, sse2::normalize, sse2::subtract,
+                sse2::weightedSum, sse2::magnitude,
+                sse2::removeJumpsLanes, sse2::normalizeLanes, sse2::detrendLanes,
+                sse2::boxFilterLanes, sse2::bandMagnitudeLanes
+            };
+            static const Kernels avx2Kernels = {
+                avx2::meanStdDev, avx2::normalize, avx2::subtract,
+                avx2::weightedSum, avx2::magnitude,
+                avx2::removeJumpsLanes, avx2::normalizeLanes, avx2::detrendLanes,
+                avx2::boxFilterLanes, avx2::bandMagnitudeLanes
+            };
+            switch (currentIsa) {
+                case AVX2: return avx2Kernels;
+                case SSE2: return sse2Kernels;
+                default: break;
+            }
+#endif
+            return scalarKernels;
+        }
+
+        Isa isa() {
+            return currentIsa;
+        }
+
+        const char *isaName() {
+            switch (currentIsa) {
+                case AVX2: return "avx2";
+                case SSE2: return "sse2";
+                default: return "scalar";
+            }
+        }
+
+        void setIsa(Isa isa) {
+            currentIsa = isa < maxIsa ? isa : maxIsa;
+        }
+
+        /* KERNELS */
+
+        void meanStdDev(const float *a, int n, double &mean, double &stdDev) {
+            kernels().meanStdDev(a, n, mean, stdDev);
+        }
+
+        void normalize(const float *a, float *b, int n) {
+            kernels().normalize(a, b, n);
+        }
+
+        void removeJumps(const float *a, const unsigned char *jumps, float *b, int n) {
+            if (n <= 0) return;
+            const Kernels &k = kernels();
+            float offset = 0;
+            int start = 0;
+            while (start < n) {
+                const int end = nextJump(jumps, start + 1, n);
+                // Read the jump before its segment is written, in case b aliases a
+                const float diff = end < n ? a[end] - a[end-1] : 0;
+                k.subtract(a + start, offset, b + start, end - start);
+                offset += diff;
+                start = end;
+            }
+        }
+
+        // Running sum, O(n) regardless of s; accumulated in double to avoid drift
+        void boxFilter(const float *a, float *b, int n, int s) {
+            if (n <= 0) return;
+            const float *ext = extend(a, n, s);
+            const double scale = 1.0 / s;
+            double sum = 0;
+            for (int k = 0; k < s - 1; k++) sum += ext[k];
+            for (int i = 0; i < n; i++) {
+                sum += ext[i + s - 1];
+                b[i] = (float)(sum * scale);
+                sum -= ext[i];
+            }
+        }
+
+        void weightedSum(const float *a, float wa, const float *b, float wb, float *c, int n) {
+            kernels().weightedSum(a, wa, b, wb, c, n);
+        }
+
+        void magnitude(const float *complex, float *mag, int n) {
+            kernels().magnitude(complex, mag, n);
+        }
+
+        /* LANE KERNELS */
+
+        void removeJumpsLanes(float *a, const unsigned char *jumps, int n, int lanes) {
+            if (n <= 0) return;
+            kernels().removeJumpsLanes(a, jumps, n, lanes);
+        }
+
+        void normalizeLanes(float *a, int n, int lanes) {
+            if (n <= 0) return;
+            kernels().normalizeLanes(a, n, lanes);
+        }
+
+        // Same factorization as cv::detrend, kept for the last size and λ
+        void detrendLanes(float *a, int n, int lanes, int lambda) {
+            if (n < 3) return;
+
+            static thread_local int factorSize = 0, factorLambda = 0;
+            static thread_local std::vector<double> diag, off1, off2, l1, l2;
+
+            if (n != factorSize || lambda != factorLambda) {
+                diag.assign(n, 1);
+                off1.assign(n, 0);
+                off2.assign(n, 0);
+                l1.assign(n, 0);
+                l2.assign(n, 0);
+
+                const double l = (double)lambda * lambda;
+                for (int k = 0; k < n - 2; k++) {
+                    diag[k] += l;
+                    diag[k+1] += 4 * l;
+                    diag[k+2] += l;
+                    off1[k] -= 2 * l;
+                    off1[k+1] -= 2 * l;
+                    off2[k] += l;
+                }
+
+                for (int i = 0; i < n; i++) {
+                    if (i >= 2) l2[i] = off2[i-2] / diag[i-2];
+                    if (i >= 1) l1[i] = (off1[i-1] - (i >= 2 ? l2[i] * diag[i-2] * l1[i-1] : 0)) / diag[i-1];
+                    if (i >= 1) diag[i] -= l1[i] * l1[i] * diag[i-1];
+                    if (i >= 2) diag[i] -= l2[i] * l2[i] * diag[i-2];
+                }
+
+                factorSize = n;
+                factorLambda = lambda;
+            }
+
+            kernels().detrendLanes(a, n, lanes, diag.data(), l1.data(), l2.data());
+        }
+
+        void boxFilterLanes(float *a, int n, int lanes, int s) {
+            if (n <= 0) return;
+            kernels().boxFilterLanes(a, n, lanes, s);
+        }
+
+        // Direct DFT of the band only, the twiddles are kept for the last length
+        void bandMagnitudeLanes(const float *a, int n, int lanes, int low, int high, float *mag) {
+            if (n <= 0 || low > high) return;
+
+            static thread_local std::vector<float> cosines, sines;
+            if ((int)cosines.size() != n) {
+                cosines.resize(n);
+                sines.resize(n);
+                for (int p = 0; p < n; p++) {
+                    cosines[p] = (float)std::cos(2 * M_PI * p / n);
+                    sines[p] = (float)std::sin(2 * M_PI * p / n);
+                }
+            }
+
+            kernels().bandMagnitudeLanes(a, n, lanes, low, high, cosines.data(), sines.data(), mag);
+        }
+    }
+}
@@ -0,0 +1,82 @@
+//
+//  dsp.hpp
+//  Heartbeat
+//
+//  Created by Philipp Rouast on 19/10/2026.
+//  Copyright © 2026 Philipp Roüast. All rights reserved.
+//
+
+#ifndef dsp_hpp
+#define dsp_hpp
+
+#include <stdio.h>
+
+namespace cv {
+
+    /* SINGLE-PRECISION DSP KERNELS
+     *
+     * All kernels operate on contiguous float arrays and support in place
+     * operation (output may alias input). The implementation is selected once
+     * at runtime: AVX2, SSE2 or a portable scalar fallback. */
+
+    namespace dsp {
+
+        enum Isa { SCALAR, SSE2, AVX2 };
+
+        // Instruction set used by the kernels
+        Isa isa();
+        const char *isaName();
+
+        // Restrict the instruction set, e.g. to compare against the scalar path
+        void setIsa(Isa isa);
+
+        // Mean and population standard deviation
+        void meanStdDev(const float *a, int n, double &mean, double &stdDev);
+
+        // Subtract mean and divide by standard deviation
+        void normalize(const float *a, float *b, int n);
+
+        // Eliminate jumps: where jumps[i] is set, subtract a[i] - a[i-1] from all a[i..n-1]
+        void removeJumps(const float *a, const unsigned char *jumps, float *b, int n);
+
+        // Box filter of size s with the same anchor and border handling as cv::blur,
+        // computed as a running sum in O(n)
+        void boxFilter(const float *a, float *b, int n, int s);
+
+        // c = wa * a + wb * b
+        void weightedSum(const float *a, float wa, const float *b, float wb, float *c, int n);
+
+        // Magnitude of n interleaved complex values (re, im)
+        void magnitude(const float *complex, float *mag, int n);
+
+        /* LANES
+         *
+         * Kernels over many signals of the same length at once, in
+         * structure-of-arrays layout: sample i of signal k is at
+         * a[i * lanes + k], so one register holds the same sample of several
+         * signals. lanes must be a multiple of LANE_WIDTH; jumps use the same
+         * layout. Every lane gives the same result as the kernel above on its
+         * own signal. */
+
+        const int LANE_WIDTH = 8;
+
+        // removeJumps of every lane, in place
+        void removeJumpsLanes(float *a, const unsigned char *jumps, int n, int lanes);
+
+        // normalize every lane, in place
+        void normalizeLanes(float *a, int n, int lanes);
+
+        // Smoothness priors detrending of every lane with the same λ as cv::detrend,
+        // in place; the factorization is computed once for all lanes
+        void detrendLanes(float *a, int n, int lanes, int lambda);
+
+        // boxFilter of every lane, in place
+        void boxFilterLanes(float *a, int n, int lanes, int s);
+
+        // DFT magnitude of every lane at bins [low, high] of n, stored at
+        // mag[(bin - low) * lanes + k]
+        void bandMagnitudeLanes(const float *a, int n, int lanes, int low, int high, float *mag);
+    }
+}
+
+#endif /* dsp_hpp */
@@ -7,11 +7,22 @@
 //
 
 #include "opencv.hpp"
+
+#include "dsp.hpp"
+#include <algorithm>
 #include <limits>
+#include <list>
+#include <map>
+#include <mutex>
+#include <vector>
 
+#include <opencv2/core/hal/hal.hpp>
 #include <opencv2/highgui.hpp>
 #include <opencv2/imgproc.hpp>
 
+#define MAX_FILTER_CACHE_BYTES (1 << 20)
+#define MAX_DFT_PLANS 16 // transform lengths planned per thread
+
 using namespace std;
 
 namespace cv {
@@ -27,7 +38,7 @@ namespace cv {
         } else if (t.rows == 1) {
             result = std::numeric_limits<double>::max();
         } else {
-            double diff = (t.at<int>(t.rows-1, 0) - t.at<int>(0, 0)) * timeBase;
+            double diff = (t.at<double>(t.rows-1, 0) - t.at<double>(0, 0)) * timeBase;
             result = diff == 0 ? std::numeric_limits<double>::max() : t.rows/diff;
         }
 
@@ -49,50 +60,59 @@ namespace cv {
 
     /* FILTERS */
 
+    // Run a single-column kernel on every column of a float matrix in place
+    template<typename Kernel>
+    static void columnwise(Mat &b, Kernel kernel) {
+        CV_Assert(b.type() == CV_32F);
+        if (b.cols == 1 && b.isContinuous()) {
+            kernel(b.ptr<float>(), b.rows);
+            return;
+        }
+        static thread_local std::vector<float> col;
+        col.resize(b.rows);
+        for (int j = 0; j < b.cols; j++) {
+            for (int i = 0; i < b.rows; i++) col[i] = b.at<float>(i, j);
+            kernel(col.data(), b.rows);
+            for (int i = 0; i < b.rows; i++) b.at<float>(i, j) = col[i];
+        }
+    }
+
     // Subtract mean and divide by standard deviation
     void normalization(InputArray _a, OutputArray _b) {
         _a.getMat().copyTo(_b);
         Mat b = _b.getMat();
-        Scalar mean, stdDev;
-        for (int i = 0; i < b.cols; i++) {
-            meanStdDev(b.col(i), mean, stdDev);
-            b.col(i) = (b.col(i) - mean[0]) / stdDev[0];
-        }
+        columnwise(b, [](float *p, int n) {
+            dsp::normalize(p, p, n);
+        });
     }
 
     // Eliminate jumps
     void denoise(InputArray _a, InputArray _jumps, OutputArray _b) {
 
-        Mat a = _a.getMat().clone();
-        Mat jumps = _jumps.getMat().clone();
+        Mat a = _a.getMat();
+        Mat jumps = _jumps.getMat();
 
-        CV_Assert(a.type() == CV_64F && jumps.type() == CV_8U);
+        CV_Assert(a.type() == CV_32F && jumps.type() == CV_8U && jumps.isContinuous());
 
         if (jumps.rows != a.rows) {
-            jumps.rowRange(jumps.rows-a.rows, jumps.rows).copyTo(jumps);
-        }
-
-        Mat diff;
-        subtract(a.rowRange(1, a.rows), a.rowRange(0, a.rows-1), diff);
-
-        for (int i = 1; i < jumps.rows; i++) {
-            if (jumps.at<bool>(i, 0)) {
-                Mat mask = Mat::zeros(a.size(), CV_8U);
-                mask.rowRange(i, mask.rows).setTo(ONE);
-                for (int j = 0; j < a.cols; j++) {
-                    add(a.col(j), -diff.at<double>(i-1, j), a.col(j), mask.col(j));
-                }
-            }
+            jumps = jumps.rowRange(jumps.rows-a.rows, jumps.rows);
         }
 
         a.copyTo(_b);
+        Mat b = _b.getMat();
+        const uchar *j = jumps.ptr<uchar>();
+        columnwise(b, [j](float *p, int n) {
+            dsp::removeJumps(p, j, p, n);
+        });
     }
 
-    // Advanced detrending filter based on smoothness priors approach (High pass equivalent)
+    // Advanced detrending filter based on smoothness priors approach (High pass equivalent).
+    // I + λ^2 * D2^t*D2 is pentadiagonal, so it is factorized as L*D*L^t with two
+    // subdiagonals and solved per column in O(rows) without forming any matrix.
     void detrend(InputArray _a, OutputArray _b, int lambda) {
 
         Mat a = _a.getMat();
-        CV_Assert(a.type() == CV_64F);
+        CV_Assert(a.type() == CV_32F);
 
         // Number of rows
         int rows = a.rows;
@@ -100,18 +120,52 @@ namespace cv {
         if (rows < 3) {
             a.copyTo(_b);
         } else {
-            // Construct I
-            Mat i = Mat::eye(rows, rows, a.type());
-            // Construct D2
-            Mat d = Mat(Matx<double,1,3>(1, -2, 1));
-            Mat d2Aux = Mat::ones(rows-2, 1, a.type()) * d;
-            Mat d2 = Mat::zeros(rows-2, rows, a.type());
-            for (int k = 0; k < 3; k++) {
-                d2Aux.col(k).copyTo(d2.diag(k));
+            // Solve in double precision, the system is ill-conditioned for large λ
+            static thread_local std::vector<double> diag, off1, off2, l1, l2, x;
+            diag.assign(rows, 1);
+            off1.assign(rows, 0);
+            off2.assign(rows, 0);
+            l1.assign(rows, 0);
+            l2.assign(rows, 0);
+            x.resize(rows);
+
+            // Bands of I + λ^2 * D2^t*D2, D2 rows being (1, -2, 1)
+            const double l = (double)lambda * lambda;
+            for (int k = 0; k < rows - 2; k++) {
+                diag[k] += l;
+                diag[k+1] += 4 * l;
+                diag[k+2] += l;
+                off1[k] -= 2 * l;
+                off1[k+1] -= 2 * l;
+                off2[k] += l;
+            }
+
+            // Factorize, diag becomes D
+            for (int i = 0; i < rows; i++) {
+                if (i >= 2) l2[i] = off2[i-2] / diag[i-2];
+                if (i >= 1) l1[i] = (off1[i-1] - (i >= 2 ? l2[i] * diag[i-2] * l1[i-1] : 0)) / diag[i-1];
+                if (i >= 1) diag[i] -= l1[i] * l1[i] * diag[i-1];
+                if (i >= 2) diag[i] -= l2[i] * l2[i] * diag[i-2];
+            }
+
+            // Calculate b = a - (I + λ^2 * D2^t*D2)^-1 * a
+            _b.create(rows, a.cols, CV_32F);
+            Mat b = _b.getMat();
+            for (int j = 0; j < a.cols; j++) {
+                for (int i = 0; i < rows; i++) {
+                    x[i] = a.at<float>(i, j);
+                    if (i >= 1) x[i] -= l1[i] * x[i-1];
+                    if (i >= 2) x[i] -= l2[i] * x[i-2];
+                }
+                for (int i = rows - 1; i >= 0; i--) {
+                    x[i] /= diag[i];
+                    if (i + 1 < rows) x[i] -= l1[i+1] * x[i+1];
+                    if (i + 2 < rows) x[i] -= l2[i+2] * x[i+2];
+                }
+                for (int i = 0; i < rows; i++) {
+                    b.at<float>(i, j) = (float)(a.at<float>(i, j) - x[i]);
+                }
             }
-            // Calculate b = (I - (I + λ^2 * D2^t*D2)^-1) * a
-            Mat b = (i - (i + lambda * lambda * d2.t() * d2).inv()) * a;
-            b.copyTo(_b);
         }
     }
 
@@ -122,13 +176,151 @@ namespace cv {
 
         _a.getMat().copyTo(_b);
         Mat b = _b.getMat();
-        for (size_t i = 0; i < n; i++) {
-            cv::blur(b, b, Size(s, s));
+        columnwise(b, [n, s](float *p, int rows) {
+            for (int i = 0; i < n; i++) {
+                dsp::boxFilter(p, p, rows, s);
+            }
+        });
+    }
+
+    // Cascaded moving average of rows [from, to) of a, storing rows [outFrom, outTo) in b
+    static void movingAverageSegment(const Mat &a, Mat &b, int n, int s,
+                                     int from, int to, int outFrom, int outTo) {
+        static thread_local std::vector<float> segment;
+        segment.resize(to - from);
+        for (int i = from; i < to; i++) segment[i - from] = a.at<float>(i, 0);
+        for (int k = 0; k < n; k++) {
+            dsp::boxFilter(segment.data(), segment.data(), to - from, s);
+        }
+        for (int i = outFrom; i < outTo; i++) b.at<float>(i, 0) = segment[i - from];
+    }
+
+    // Update the moving average b of a signal a which lost samples at the front
+    // and gained added samples at the back since b was computed. Only the samples
+    // whose kernel support reaches a border or a new sample are recomputed.
+    void movingAverageUpdate(InputArray _a, InputOutputArray _b, int n, int s,
+                             int dropped, int added) {
+
+        CV_Assert(s > 0);
+
+        Mat a = _a.getMat();
+        Mat b = _b.getMat();
+        CV_Assert(a.type() == CV_32F && b.type() == CV_32F &&
+                  a.cols == 1 && b.cols == 1 && a.rows == b.rows);
+
+        const int rows = a.rows;
+        const int left = n * (s / 2);
+        const int right = n * (s - 1 - s / 2);
+        const int headEnd = dropped > 0 ? left : 0;
+        const int tailStart = rows - added - right;
+
+        // Near the front, reflection makes outputs depend on up to left + right samples
+        if (headEnd >= tailStart || rows - added <= 2 * (left + right) + 1) {
+            movingAverageSegment(a, b, n, s, 0, rows, 0, rows);
+        } else {
+            if (headEnd > 0) {
+                movingAverageSegment(a, b, n, s, 0, std::min(2 * left + right + 1, rows), 0, headEnd);
+            }
+            movingAverageSegment(a, b, n, s, std::max(tailStart - left, 0), rows, tailStart, rows);
+        }
+    }
+
+    // Weighted sum of two signals
+    void combine(InputArray _a, double alpha, InputArray _b, double beta, OutputArray _c) {
+
+        Mat a = _a.getMat();
+        Mat b = _b.getMat();
+        CV_Assert(a.type() == CV_32F && b.type() == CV_32F && a.size() == b.size() &&
+                  a.isContinuous() && b.isContinuous());
+
+        _c.create(a.size(), CV_32F);
+        Mat c = _c.getMat();
+        dsp::weightedSum(a.ptr<float>(), (float)alpha, b.ptr<float>(), (float)beta,
+                         c.ptr<float>(), (int)a.total());
+    }
+
+    // Scratch stores for transforms, one set per thread. The stores only grow,
+    // so a window length that changes from call to call reuses their storage.
+    struct DftScratch {
+        Mat in;
+        Mat ccs;
+        Mat out;
+        Mat band;
+        Mat mag;
+        Mat work;
+        Mat columns;
+        Mat channels;
+        Mat components;
+    };
+
+    static DftScratch &dftScratch() {
+        static thread_local DftScratch scratch;
+        return scratch;
+    }
+
+    // Continuous rows x cols float view at the start of a store, grown to fit
+    static Mat scratchView(Mat &store, int rows, int cols) {
+        const size_t size = (size_t)rows * cols;
+        if (store.total() < size) {
+            store.create(1, (int)size, CV_32F);
+        }
+        return Mat(rows, cols, CV_32F, store.data);
+    }
+
+    // Real transform plans of one length and direction. cv::dft plans, and so
+    // allocates, on every call; a plan here is kept until MAX_DFT_PLANS other
+    // plans were used since.
+    struct DftPlan {
+        int length;
+        int flags;
+        uint64 used;
+        Ptr<hal::DFT1D> plan;
+    };
+
+    static hal::DFT1D &dftPlan(int length, int flags) {
+        static thread_local DftPlan plans[MAX_DFT_PLANS];
+        static thread_local uint64 clock = 0;
+        DftPlan *slot = plans;
+        for (DftPlan &p : plans) {
+            if (p.plan && p.length == length && p.flags == flags) {
+                p.used = ++clock;
+                return *p.plan;
+            }
+            if (p.used < slot->used) slot = &p;
+        }
+        slot->length = length;
+        slot->flags = flags;
+        slot->used = ++clock;
+        slot->plan = hal::DFT1D::create(length, 1, CV_32F, flags);
+        return *slot->plan;
+    }
+
+    // CCS packed transform of n real samples, or the unscaled inverse of a CCS
+    // packed spectrum. Odd lengths are transformed as complex signals of the
+    // full length, so the plan writes into scratch and n values are copied out.
+    static void realDft(const float *a, float *b, int n, bool inverse) {
+        Mat work = scratchView(dftScratch().work, 2 * n + 2, 1);
+        const int flags = CV_HAL_DFT_REAL_OUTPUT | (inverse ? CV_HAL_DFT_INVERSE : 0);
+        dftPlan(n, flags).apply((const uchar *)a, work.data);
+        std::copy(work.ptr<float>(), work.ptr<float>() + n, b);
+    }
+
+    void reserveTransforms(int n) {
+        n = getOptimalDFTSize(n);
+        DftScratch &scratch = dftScratch();
+        Mat *columns[] = {&scratch.in, &scratch.ccs, &scratch.out, &scratch.band, &scratch.mag};
+        for (Mat *store : columns) {
+            scratchView(*store, n, 1);
+        }
+        scratchView(scratch.work, 2 * n + 2, 1);
+        Mat *rows[] = {&scratch.columns, &scratch.channels, &scratch.components};
+        for (Mat *store : rows) {
+            scratchView(*store, 3, n);
         }
     }
 
     // Bandpass filter
-    void bandpass(cv::InputArray _a, cv::OutputArray _b, double low, double high) {
+    void bandpass(cv::InputArray _a, cv::OutputArray _b, double low, double high, bool pad) {
 
         Mat a = _a.getMat();
 
@@ -136,131 +328,743 @@ namespace cv {
             a.copyTo(_b);
         } else {
 
+            const int n = (int)a.total();
+            Mat band = scratchView(dftScratch().band, pad ? getOptimalDFTSize(n) : n, 1);
+
             // Convert to frequency domain
-            Mat frequencySpectrum = Mat(a.rows, a.cols, CV_32F);
-            timeToFrequency(a, frequencySpectrum, false);
+            timeToFrequency(a, band, false, pad);
 
-            // Make the filter
-            Mat filter = frequencySpectrum.clone();
-            butterworth_bandpass_filter(filter, low, high, 8);
+            // Look up the filter, with cutoffs scaled to the padded length
+            const double scale = (double)band.rows / n;
+            Mat filter = butterworth_bandpass_response(band.rows, low * scale, high * scale, 8);
 
             // Apply the filter
-            multiply(frequencySpectrum, filter, frequencySpectrum);
+            multiply(band, filter, band);
 
             // Convert to time domain
-            frequencyToTime(frequencySpectrum, _b);
+            frequencyToTime(band, _b, n);
         }
     }
 
+    // Frequency bin of row i in a CCS packed spectrum
+    static inline int ccsBin(int i) {
+        return (i + 1) / 2;
+    }
+
     void butterworth_lowpass_filter(Mat &filter, double cutoff, int n) {
-        CV_DbgAssert(cutoff > 0 && n > 0 && filter.rows % 2 == 0 && filter.cols % 2 == 0);
+        CV_DbgAssert(cutoff > 0 && n > 0 && filter.cols == 1);
 
-        Mat tmp = Mat(filter.rows, filter.cols, CV_32F);
-        //Point centre = Point(filter.rows / 2, filter.cols / 2);
-        double radius;
+        filter.create(filter.rows, 1, CV_32F);
 
         for (int i = 0; i < filter.rows; i++) {
-            for (int j = 0; j < filter.cols; j++) {
-                radius = i;
-                //radius = (double)sqrt(pow((i - centre.x), 2.0) + pow((double) (j - centre.y), 2.0));
-                tmp.at<float>(i, j) = (float)(1 / (1 + pow(radius / cutoff, 2 * n)));
-            }
+            double radius = ccsBin(i);
+            filter.at<float>(i, 0) = (float)(1 / (1 + pow(radius / cutoff, 2 * n)));
         }
-
-        Mat toMerge[] = {tmp, tmp};
-        merge(toMerge, 2, filter);
     }
 
     void butterworth_bandpass_filter(Mat &filter, double cutin, double cutoff, int n) {
-        CV_DbgAssert(cutoff > 0 && cutin < cutoff && n > 0 &&
-                     filter.rows % 2 == 0 && filter.cols % 2 == 0);
+        CV_DbgAssert(cutoff > 0 && cutin < cutoff && n > 0 && filter.cols == 1);
         Mat off = filter.clone();
         butterworth_lowpass_filter(off, cutoff, n);
         Mat in = filter.clone();
         butterworth_lowpass_filter(in, cutin, n);
-        filter = off - in;
+        subtract(off, in, filter);
+    }
+
+    // Filter responses shared by all streams, least recently used first out
+    struct FilterKey {
+        int length;
+        double cutin;
+        double cutoff;
+        int order;
+
+        bool operator<(const FilterKey &o) const {
+            if (length != o.length) return length < o.length;
+            if (cutin != o.cutin) return cutin < o.cutin;
+            if (cutoff != o.cutoff) return cutoff < o.cutoff;
+            return order < o.order;
+        }
+    };
+
+    typedef std::list<std::pair<FilterKey, Mat> > FilterList;
+
+    static std::mutex filterMutex;
+    static FilterList filterList;
+    static std::map<FilterKey, FilterList::iterator> filterIndex;
+    static size_t filterBytes = 0;
+
+    // The returned response is shared between callers and must not be modified
+    Mat butterworth_bandpass_response(int length, double cutin, double cutoff, int order) {
+
+        const FilterKey key = {length, cutin, cutoff, order};
+        std::lock_guard<std::mutex> lock(filterMutex);
+
+        // Hit: move to front
+        std::map<FilterKey, FilterList::iterator>::iterator it = filterIndex.find(key);
+        if (it != filterIndex.end()) {
+            filterList.splice(filterList.begin(), filterList, it->second);
+            return it->second->second;
+        }
+
+        // Miss: generate
+        Mat filter = Mat(length, 1, CV_32F);
+        butterworth_bandpass_filter(filter, cutin, cutoff, order);
+        filterList.push_front(std::make_pair(key, filter));
+        filterIndex[key] = filterList.begin();
+        filterBytes += length * sizeof(float);
+
+        // Evict until within bound, keeping at least the new entry
+        while (filterBytes > MAX_FILTER_CACHE_BYTES && filterList.size() > 1) {
+            const std::pair<FilterKey, Mat> &last = filterList.back();
+            filterBytes -= last.second.total() * sizeof(float);
+            filterIndex.erase(last.first);
+            filterList.pop_back();
+        }
+
+        return filter;
+    }
+
+    // Magnitudes of a CCS packed spectrum, mirrored to all n bins
+    static void ccsMagnitude(const float *ccs, float *mag, int n) {
+        mag[0] = std::abs(ccs[0]);
+        dsp::magnitude(ccs + 1, mag + 1, (n - 1) / 2);
+        if (n % 2 == 0) {
+            mag[n/2] = std::abs(ccs[n-1]);
+        }
+        for (int k = n/2 + 1; k < n; k++) {
+            mag[k] = mag[n-k];
+        }
     }
 
-    void timeToFrequency(InputArray _a, OutputArray _b, bool magnitude) {
+    // Real-input transform; the spectrum is CCS packed unless magnitude is requested
+    void timeToFrequency(InputArray _a, OutputArray _b, bool magnitude, bool pad) {
 
-        // Prepare planes
         Mat a = _a.getMat();
-        Mat planes[] = {cv::Mat_<float>(a), cv::Mat::zeros(a.size(), CV_32F)};
-        Mat powerSpectrum;
-        merge(planes, 2, powerSpectrum);
+        CV_Assert(a.cols == 1);
 
-        // Fourier transform
-        dft(powerSpectrum, powerSpectrum, DFT_COMPLEX_OUTPUT);
+        // Copy into the (padded) input buffer
+        const int n = pad ? getOptimalDFTSize(a.rows) : a.rows;
+        DftScratch &scratch = dftScratch();
+        Mat in = scratchView(scratch.in, n, 1);
+        a.convertTo(in.rowRange(0, a.rows), CV_32F);
+        in.rowRange(a.rows, n).setTo(ZERO);
 
+        // Fourier transform
+        _b.create(n, 1, CV_32F);
+        Mat b = _b.getMat();
+        CV_Assert(b.isContinuous());
         if (magnitude) {
-            split(powerSpectrum, planes);
-            cv::magnitude(planes[0], planes[1], planes[0]);
-            planes[0].copyTo(_b);
+            Mat ccs = scratchView(scratch.ccs, n, 1);
+            realDft(in.ptr<float>(), ccs.ptr<float>(), n, false);
+            ccsMagnitude(ccs.ptr<float>(), b.ptr<float>(), n);
         } else {
-            powerSpectrum.copyTo(_b);
+            realDft(in.ptr<float>(), b.ptr<float>(), n, false);
         }
     }
 
-    void frequencyToTime(InputArray _a, OutputArray _b) {
+    // Real-output inverse transform of a CCS packed spectrum, scaled to [0, 1]
+    void frequencyToTime(InputArray _a, OutputArray _b, int length) {
 
         Mat a = _a.getMat();
+        CV_Assert(a.type() == CV_32F && a.cols == 1 && a.isContinuous());
+        if (length < 0) length = a.rows;
 
         // Inverse fourier transform
-        idft(a, a);
+        Mat out = scratchView(dftScratch().out, a.rows, 1);
+        realDft(a.ptr<float>(), out.ptr<float>(), a.rows, true);
 
-        // Split into planes; plane 0 is output
-        Mat outputPlanes[2];
-        split(a, outputPlanes);
-        Mat output = Mat(a.rows, 1, a.type());
-        normalize(outputPlanes[0], output, 0, 1, NORM_MINMAX);
-        output.copyTo(_b);
+        // Drop the padding
+        normalize(out.rowRange(0, length), _b, 0, 1, NORM_MINMAX);
     }
 
-    void pcaComponent(cv::InputArray _a, cv::OutputArray _b, cv::OutputArray _pc, int low, int high) {
+    // Offset of a magnitude spectrum peak from its bin, in [-0.5, 0.5] bins.
+    // Fits a Gaussian through the peak and its neighbours, i.e. a parabola
+    // through the log magnitudes; falls back to a parabola on the magnitudes.
+    double interpolatePeak(InputArray _a, int peak) {
 
         Mat a = _a.getMat();
-        CV_Assert(a.type() == CV_64F);
+        CV_Assert(a.type() == CV_32F && a.cols == 1);
 
-        // Perform PCA
-        cv::PCA pca(a, cv::Mat(), PCA::DATA_AS_ROW);
+        if (peak <= 0 || peak >= a.rows - 1) {
+            return 0;
+        }
 
-        // Calculate PCA components
-        cv::Mat pc = a * pca.eigenvectors.t();
+        double l = a.at<float>(peak - 1, 0);
+        double c = a.at<float>(peak, 0);
+        double r = a.at<float>(peak + 1, 0);
+        if (l > 0 && c > 0 && r > 0) {
+            l = std::log(l);
+            c = std::log(c);
+            r = std::log(r);
+        }
+
+        // Not a local maximum, e.g. a peak at the band edge
+        const double d = l - 2 * c + r;
+        if (d >= 0) {
+            return 0;
+        }
+
+        return std::max(-0.5, std::min(0.5, 0.5 * (l - r) / d));
+    }
+
+    // Signal-to-noise ratio in dB of a magnitude spectrum within [low, high]:
+    // power in the bins around the peak and its first harmonic over the
+    // power in the remaining band bins.
+    double spectralSnr(InputArray _a, int peak, int low, int high) {
+
+        Mat a = _a.getMat();
+        CV_Assert(a.type() == CV_32F && a.cols == 1);
+
+        low = std::max(low, 0);
+        high = std::min(high, a.rows - 1);
+
+        double signal = 0, noise = 0;
+        for (int i = low; i <= high; i++) {
+            const double p = (double)a.at<float>(i, 0) * a.at<float>(i, 0);
+            if (std::abs(i - peak) <= 1 || std::abs(i - 2 * peak) <= 1) {
+                signal += p;
+            } else {
+                noise += p;
+            }
+        }
 
-        // Band mask
+        if (signal <= 0) {
+            return -std::numeric_limits<double>::infinity();
+        }
+        if (noise <= 0) {
+            return std::numeric_limits<double>::infinity();
+        }
+        return 10 * std::log10(signal / noise);
+    }
+
+    // Peak of the band magnitude spectrum normalized to unit L1 norm, for the
+    // projections of a onto each row of vectors. The channels are transformed
+    // once; by linearity the component spectra are combinations of theirs.
+    static void periodicity(const Mat &a, const Mat &vectors, int low, int high, double *vals) {
+
+        CV_Assert(a.type() == CV_32F && vectors.type() == CV_32F && vectors.cols == a.cols && a.cols >= 2);
+
+        // Band limits
         const int total = a.rows;
-        Mat bandMask = Mat::zeros(a.rows, 1, CV_8U);
-        bandMask.rowRange(min(low, total), min(high, total) + 1).setTo(ONE);
+        const Range band(min(low, total), min(high + 1, total));
 
-        // Identify most distinct
-        std::vector<double> vals;
-        for (int i = 0; i < pc.cols; i++) {
-            cv::Mat magnitude = Mat(pc.rows, 1, CV_32F);
-            // Calculate spectral magnitudes
-            cv::timeToFrequency(pc.col(i), magnitude, true);
-            // Normalize
-            //printMat<float>("magnitude1", magnitude);
-            cv::normalize(magnitude, magnitude, 1, 0, NORM_L1, -1, bandMask);
-            //printMat<float>("magnitude2", magnitude);
-            // Grab index of max
-            double min, max;
-            Point pmin, pmax;
-            cv::minMaxLoc(magnitude, &min, &max, &pmin, &pmax, bandMask);
-            vals.push_back(max);
+        // Channel spectra, one CCS packed row per channel
+        DftScratch &scratch = dftScratch();
+        Mat columns = scratchView(scratch.columns, a.cols, total);
+        Mat channels = scratchView(scratch.channels, a.cols, total);
+        transpose(a, columns);
+        for (int j = 0; j < a.cols; j++) {
+            realDft(columns.ptr<float>(j), channels.ptr<float>(j), total, false);
+        }
 
+        // Component spectra
+        Mat components = scratchView(scratch.components, vectors.rows, total);
+        for (int k = 0; k < vectors.rows; k++) {
+            const float *v = vectors.ptr<float>(k);
+            float *c = components.ptr<float>(k);
+            dsp::weightedSum(channels.ptr<float>(0), v[0], channels.ptr<float>(1), v[1], c, total);
+            for (int j = 2; j < a.cols; j++) {
+                dsp::weightedSum(c, 1, channels.ptr<float>(j), v[j], c, total);
+            }
         }
 
+        // Calculate spectral magnitudes
+        Mat mag = scratchView(scratch.mag, total, 1);
+        for (int k = 0; k < vectors.rows; k++) {
+            ccsMagnitude(components.ptr<float>(k), mag.ptr<float>(), total);
+            Mat bandMagnitude = mag.rowRange(band);
+            double max;
+            cv::minMaxLoc(bandMagnitude, 0, &max);
+            vals[k] = max / cv::norm(bandMagnitude, NORM_L1);
+        }
+    }
+
+    // Projection of the rows of a onto v
+    static void project(const Mat &a, const Vec3d &v, OutputArray _b) {
+        _b.create(a.rows, 1, CV_32F);
+        Mat b = _b.getMat();
+        for (int i = 0; i < a.rows; i++) {
+            const float *x = a.ptr<float>(i);
+            b.at<float>(i, 0) = (float)(x[0] * v[0] + x[1] * v[1] + x[2] * v[2]);
+        }
+    }
+
+    // Covariance of the rows of a, shared by the batch and streaming selection
+    static Matx33d windowCovariance(const Mat &a, RunningCovariance &covariance) {
+        covariance.reset();
+        for (int i = 0; i < a.rows; i++) {
+            covariance.add(a.ptr<float>(i));
+        }
+        return covariance.covariance();
+    }
+
+    void pcaComponent(cv::InputArray _a, cv::OutputArray _b, cv::OutputArray _pc, int low, int high) {
+
+        Mat a = _a.getMat();
+        CV_Assert(a.type() == CV_32F && a.cols == 3);
+
+        // Perform PCA, eigenvectors of the covariance as rows
+        RunningCovariance covariance;
+        Vec3d values;
+        Matx33d vectors;
+        eigenSymmetric3(windowCovariance(a, covariance), values, vectors);
+        Matx33f eigenvectors(vectors);
+        Mat e(3, 3, CV_32F, eigenvectors.val);
+
+        // Identify most distinct
+        double vals[3];
+        periodicity(a, e, low, high, vals);
+
         // Select most distinct
-        int idx[2];
-        cv::minMaxIdx(vals, 0, 0, 0, &idx[0]);
-        if (idx[0] == -1) {
-            pc.col(1).copyTo(_b);
+        int idx = (int)(std::max_element(vals, vals + 3) - vals);
+        project(a, Vec3d(vectors(idx, 0), vectors(idx, 1), vectors(idx, 2)), _b);
+
+        // Calculate PCA components
+        if (_pc.needed()) {
+            gemm(a, e, 1, noArray(), 0, _pc, GEMM_2_T);
+        }
+    }
+
+    /* STREAMING PCA */
+
+    void RunningCovariance::reset() {
+        n = 0;
+        for (int i = 0; i < 3; i++) {
+            origin[i] = 0;
+            sum[i] = 0;
+            for (int j = 0; j < 3; j++) sumSq[i][j] = 0;
+        }
+    }
+
+    // Sums are kept relative to the first sample to limit cancellation
+    void RunningCovariance::add(const float *x) {
+        if (n == 0) {
+            for (int i = 0; i < 3; i++) origin[i] = x[i];
+        }
+        double d[3];
+        for (int i = 0; i < 3; i++) {
+            d[i] = x[i] - origin[i];
+            sum[i] += d[i];
+        }
+        for (int i = 0; i < 3; i++) {
+            for (int j = i; j < 3; j++) sumSq[i][j] += d[i] * d[j];
+        }
+        n++;
+    }
+
+    Matx33d RunningCovariance::covariance() const {
+        Matx33d c;
+        if (n == 0) return c;
+        for (int i = 0; i < 3; i++) {
+            for (int j = i; j < 3; j++) {
+                c(i, j) = c(j, i) = sumSq[i][j] / n - (sum[i] / n) * (sum[j] / n);
+            }
+        }
+        return c;
+    }
+
+    static inline Vec3d cross3(const Vec3d &a, const Vec3d &b) {
+        return Vec3d(a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0]);
+    }
+
+    // Unit eigenvector for eigenvalue l as the largest cross product of rows of A - lI
+    static bool eigenvector3(const Matx33d &a, double l, double scale, Vec3d &v) {
+        Vec3d r0(a(0, 0) - l, a(0, 1), a(0, 2));
+        Vec3d r1(a(1, 0), a(1, 1) - l, a(1, 2));
+        Vec3d r2(a(2, 0), a(2, 1), a(2, 2) - l);
+        Vec3d c[] = {cross3(r0, r1), cross3(r0, r2), cross3(r1, r2)};
+        int best = 0;
+        for (int k = 1; k < 3; k++) {
+            if (c[k].dot(c[k]) > c[best].dot(c[best])) best = k;
+        }
+        const double n2 = c[best].dot(c[best]);
+        if (n2 <= 1e-12 * scale * scale * scale * scale) return false;
+        v = c[best] * (1 / std::sqrt(n2));
+        return true;
+    }
+
+    // Closed-form eigen decomposition of a symmetric 3x3 matrix. Eigenvalues are
+    // in descending order, eigenvectors are rows, as returned by cv::eigen.
+    void eigenSymmetric3(const Matx33d &a, Vec3d &values, Matx33d &vectors) {
+
+        const double p1 = a(0, 1) * a(0, 1) + a(0, 2) * a(0, 2) + a(1, 2) * a(1, 2);
+        const double q = (a(0, 0) + a(1, 1) + a(2, 2)) / 3;
+        const double p2 = (a(0, 0) - q) * (a(0, 0) - q) + (a(1, 1) - q) * (a(1, 1) - q) +
+                          (a(2, 2) - q) * (a(2, 2) - q) + 2 * p1;
+        const double p = std::sqrt(p2 / 6);
+
+        Vec3d v0, v2;
+        if (p > 0) {
+            // Eigenvalues from the trigonometric solution of the characteristic polynomial
+            Matx33d b = (a - Matx33d::eye() * q) * (1 / p);
+            double r = (b(0, 0) * (b(1, 1) * b(2, 2) - b(1, 2) * b(2, 1)) -
+                        b(0, 1) * (b(1, 0) * b(2, 2) - b(1, 2) * b(2, 0)) +
+                        b(0, 2) * (b(1, 0) * b(2, 1) - b(1, 1) * b(2, 0))) / 2;
+            r = std::min(1.0, std::max(-1.0, r));
+            const double phi = std::acos(r) / 3;
+            values[0] = q + 2 * p * std::cos(phi);
+            values[2] = q + 2 * p * std::cos(phi + 2 * CV_PI / 3);
+            values[1] = 3 * q - values[0] - values[2];
+
+            if (eigenvector3(a, values[0], p, v0) && eigenvector3(a, values[2], p, v2)) {
+                Vec3d v1 = cross3(v2, v0);
+                for (int j = 0; j < 3; j++) {
+                    vectors(0, j) = v0[j];
+                    vectors(1, j) = v1[j];
+                    vectors(2, j) = v2[j];
+                }
+                return;
+            }
+        }
+
+        // Repeated eigenvalues leave the eigenvectors underdetermined
+        Mat eigenvalues, eigenvectors;
+        cv::eigen(Mat(a), eigenvalues, eigenvectors);
+        for (int i = 0; i < 3; i++) {
+            values[i] = eigenvalues.at<double>(i, 0);
+            for (int j = 0; j < 3; j++) vectors(i, j) = eigenvectors.at<double>(i, j);
+        }
+    }
+
+    void StreamingPCA::reset() {
+        covariance.reset();
+        valid = false;
+        rescored = false;
+    }
+
+    void StreamingPCA::component(InputArray _a, OutputArray _b, OutputArray _pc,
+                                 int low, int high, double maxAngle) {
+
+        Mat a = _a.getMat();
+        CV_Assert(a.type() == CV_32F && a.cols == 3);
+
+        // Same decomposition as the batch path; the detrended window changes as
+        // a whole every frame, so its covariance is one pass rather than a
+        // running update
+        Vec3d values;
+        Matx33d vectors;
+        eigenSymmetric3(windowCovariance(a, covariance), values, vectors);
+
+        // Eigenvector closest to the current selection
+        int idx = 0;
+        double best = -1;
+        for (int k = 0; valid && k < 3; k++) {
+            double d = std::abs(vectors(k, 0) * selected[0] + vectors(k, 1) * selected[1] +
+                                vectors(k, 2) * selected[2]);
+            if (d > best) {
+                best = d;
+                idx = k;
+            }
+        }
+
+        // Rescore the components only if the selection rotated too far
+        rescored = !valid || best < std::cos(maxAngle);
+        Matx33f eigenvectors(vectors);
+        Mat e(3, 3, CV_32F, eigenvectors.val);
+        if (rescored) {
+            double vals[3];
+            periodicity(a, e, low, high, vals);
+            idx = (int)(std::max_element(vals, vals + 3) - vals);
+        }
+
+        // Keep the sign stable so the signal does not flip between frames
+        Vec3d v(vectors(idx, 0), vectors(idx, 1), vectors(idx, 2));
+        if (valid && v.dot(selected) < 0) v = v * -1.0;
+        selected = v;
+        valid = true;
+
+        project(a, selected, _b);
+
+        if (_pc.needed()) {
+            gemm(a, e, 1, noArray(), 0, _pc, GEMM_2_T);
+        }
+    }
+
+    /* PULSE PROJECTIONS */
+
+    // Channels of the BGR means divided by their temporal mean
+    static void temporalNormalization(const Mat &c, Mat &n) {
+        CV_Assert(c.type() == CV_32F && c.cols == 3);
+        Scalar m = mean(c.reshape(3));
+        n.create(c.rows, 3, CV_32F);
+        for (int i = 0; i < c.rows; i++) {
+            const float *x = c.ptr<float>(i);
+            float *y = n.ptr<float>(i);
+            for (int j = 0; j < 3; j++) {
+                y[j] = m(j) > 0 ? (float)(x[j] / m(j)) : 0;
+            }
+        }
+    }
+
+    // h = a + (std(a) / std(b)) * sign * b, zero mean
+    static void tuneAndCombine(const Mat &a, const Mat &b, double sign, Mat &h) {
+        double meanA, stdA, meanB, stdB;
+        dsp::meanStdDev(a.ptr<float>(), a.rows, meanA, stdA);
+        dsp::meanStdDev(b.ptr<float>(), b.rows, meanB, stdB);
+        const double alpha = stdB > 0 ? sign * stdA / stdB : 0;
+        dsp::weightedSum(a.ptr<float>(), 1, b.ptr<float>(), (float)alpha, h.ptr<float>(), h.rows);
+        h -= meanA + alpha * meanB;
+    }
+
+    void posProjection(InputArray _c, OutputArray _h) {
+
+        // Scratch grows to the largest sub-window, so frame rate jitter does not reallocate
+        static thread_local Mat nStore, s1Store, s2Store;
+        const int rows = _c.rows();
+        Mat n = scratchView(nStore, rows, 3);
+        temporalNormalization(_c.getMat(), n);
+
+        // Projection onto the plane orthogonal to skin tone
+        Mat1f s1 = scratchView(s1Store, rows, 1);
+        Mat1f s2 = scratchView(s2Store, rows, 1);
+        for (int i = 0; i < n.rows; i++) {
+            const float *x = n.ptr<float>(i);
+            s1(i) = x[1] - x[0];
+            s2(i) = x[1] + x[0] - 2 * x[2];
+        }
+
+        _h.create(n.rows, 1, CV_32F);
+        Mat h = _h.getMat();
+        tuneAndCombine(s1, s2, 1, h);
+    }
+
+    void chromProjection(InputArray _c, OutputArray _h) {
+
+        static thread_local Mat nStore, xStore, yStore;
+        const int rows = _c.rows();
+        Mat n = scratchView(nStore, rows, 3);
+        temporalNormalization(_c.getMat(), n);
+
+        // Chrominance signals
+        Mat1f x = scratchView(xStore, rows, 1);
+        Mat1f y = scratchView(yStore, rows, 1);
+        for (int i = 0; i < n.rows; i++) {
+            const float *v = n.ptr<float>(i);
+            x(i) = 3 * v[2] - 2 * v[1];
+            y(i) = 1.5f * v[2] + v[1] - 1.5f * v[0];
+        }
+
+        _h.create(n.rows, 1, CV_32F);
+        Mat h = _h.getMat();
+        tuneAndCombine(x, y, -1, h);
+
+        // Hann window for overlap-add
+        for (int i = 0; i < h.rows; i++) {
+            h.at<float>(i, 0) *= (float)(0.5 - 0.5 * std::cos(2 * CV_PI * (i + 1) / (h.rows + 1)));
+        }
+    }
+
+    /* STREAMING FILTERS */
+
+    void IIRBandpass::design(double low, double high, double fs, int order) {
+        CV_Assert(low > 0 && low < high && fs > 0 && order > 0 && order % 2 == 0);
+
+        // Keep the upper edge below Nyquist
+        high = std::min(high, 0.45 * fs);
+        low = std::min(low, 0.5 * high);
+
+        // Section Q factors of a Butterworth filter of this order
+        std::vector<Biquad> previous;
+        previous.swap(sections);
+        for (int k = 0; k < order / 2; k++) {
+            double q = 1 / (2 * cos(CV_PI * (2 * k + 1) / (2 * order)));
+            addSection(low, q, fs, true);
+            addSection(high, q, fs, false);
+        }
+        rate = fs;
+
+        // Carry the state over when redesigning for a new rate
+        if (previous.size() == sections.size()) {
+            for (size_t i = 0; i < sections.size(); i++) {
+                sections[i].z1 = previous[i].z1;
+                sections[i].z2 = previous[i].z2;
+            }
+        }
+    }
+
+    // Bilinear transform biquad prewarped at f0
+    void IIRBandpass::addSection(double f0, double q, double fs, bool highpass) {
+        const double w0 = 2 * CV_PI * f0 / fs;
+        const double cosw0 = cos(w0);
+        const double alpha = sin(w0) / (2 * q);
+        const double a0 = 1 + alpha;
+        Biquad b;
+        if (highpass) {
+            b.b0 = (1 + cosw0) / 2 / a0;
+            b.b1 = -(1 + cosw0) / a0;
         } else {
-            //pc.col(1).copyTo(_b);
-            pc.col(idx[1]).copyTo(_b);
+            b.b0 = (1 - cosw0) / 2 / a0;
+            b.b1 = (1 - cosw0) / a0;
+        }
+        b.b2 = b.b0;
+        b.a1 = -2 * cosw0 / a0;
+        b.a2 = (1 - alpha) / a0;
+        b.z1 = b.z2 = 0;
+        sections.push_back(b);
+    }
+
+    void IIRBandpass::reset() {
+        for (size_t i = 0; i < sections.size(); i++) {
+            sections[i].z1 = sections[i].z2 = 0;
+        }
+    }
+
+    // Transposed direct form II
+    float IIRBandpass::filter(float x) {
+        double v = x;
+        for (size_t i = 0; i < sections.size(); i++) {
+            Biquad &b = sections[i];
+            const double y = b.b0 * v + b.z1;
+            b.z1 = b.b1 * v - b.a1 * y + b.z2;
+            b.z2 = b.b2 * v - b.a2 * y;
+            v = y;
+        }
+        return (float)v;
+    }
+
+    /* STREAMING SPECTRA */
+
+    void WelchSpectrum::configure(int length, int hop, int channels) {
+        CV_Assert(length > 1 && hop > 0 && channels > 0);
+
+        this->length = length;
+        this->hop = hop;
+        this->channels = channels;
+
+        // Hann window
+        window.create(1, length, CV_32F);
+        for (int i = 0; i < length; i++) {
+            window.at<float>(0, i) = (float)(0.5 - 0.5 * std::cos(2 * CV_PI * i / (length - 1)));
+        }
+
+        reset();
+    }
+
+    // Segment buffers are kept for reuse; configure() changes their size anyway
+    void WelchSpectrum::reset() {
+        for (size_t i = 0; i < cache.size(); i++) {
+            spares.push_back(cache[i].power);
+        }
+        cache.clear();
+    }
+
+    void WelchSpectrum::update(InputArray _a, int64_t start, bool reuse) {
+
+        Mat a = _a.getMat();
+        CV_Assert(configured() && a.type() == CV_32F && a.cols == channels);
+
+        if (!reuse) {
+            reset();
+        }
+
+        // Drop segments that left the window, keeping their buffers for reuse
+        while (!cache.empty() && cache.front().start < start) {
+            sum -= cache.front().power;
+            spares.push_back(cache.front().power);
+            cache.erase(cache.begin());
+        }
+
+        // Transform the newly completed segments
+        const int64_t end = start + a.rows;
+        int64_t next = cache.empty() ? (start + hop - 1) / hop * hop : cache.back().start + hop;
+        for (; next + length <= end; next += hop) {
+            Segment segment;
+            segment.start = next;
+            if (!spares.empty()) {
+                segment.power = spares.back();
+                spares.pop_back();
+            }
+            transform(a, (int)(next - start), segment.power);
+            if (cache.empty()) {
+                segment.power.copyTo(sum);
+            } else {
+                sum += segment.power;
+            }
+            cache.push_back(segment);
         }
+    }
+
+    // Real parts of the cross spectra X_i X_j* for i <= j, one row per pair
+    void WelchSpectrum::transform(const Mat &a, int offset, Mat &power) {
 
-        pc.copyTo(_pc);
+        const int bins = length / 2 + 1;
+        ccs.create(channels, length, CV_32F);
+        for (int c = 0; c < channels; c++) {
+            transpose(a.col(c).rowRange(offset, offset + length), buffer);
+            multiply(buffer, window, buffer);
+            realDft(buffer.ptr<float>(), ccs.ptr<float>(c), length, false);
+        }
+
+        power.create(channels * (channels + 1) / 2, bins, CV_64F);
+        for (int i = 0, p = 0; i < channels; i++) {
+            const float *x = ccs.ptr<float>(i);
+            for (int j = i; j < channels; j++, p++) {
+                const float *y = ccs.ptr<float>(j);
+                double *out = power.ptr<double>(p);
+                out[0] = (double)x[0] * y[0];
+                for (int k = 1; k < (length + 1) / 2; k++) {
+                    out[k] = (double)x[2*k-1] * y[2*k-1] + (double)x[2*k] * y[2*k];
+                }
+                if (length % 2 == 0) {
+                    out[length/2] = (double)x[length-1] * y[length-1];
+                }
+            }
+        }
+    }
+
+    void WelchSpectrum::spectrum(const double *weights, OutputArray _b) const {
+
+        if (cache.empty()) {
+            _b.release();
+            return;
+        }
+
+        _b.create(length, 1, CV_32F);
+        Mat b = _b.getMat();
+
+        const int bins = length / 2 + 1;
+        for (int k = 0; k < bins; k++) {
+            double power = 0;
+            for (int i = 0, p = 0; i < channels; i++) {
+                for (int j = i; j < channels; j++, p++) {
+                    power += (i == j ? 1 : 2) * weights[i] * weights[j] * sum.at<double>(p, k);
+                }
+            }
+            b.at<float>(k, 0) = (float)std::sqrt(std::max(power, 0.0) / cache.size());
+        }
+
+        // Mirror to the full length
+        for (int k = bins; k < length; k++) {
+            b.at<float>(k, 0) = b.at<float>(length - k, 0);
+        }
+    }
+
+    /* WORKSPACE */
+
+    void Workspace::bind(Mat &buffer, int rows, int cols) {
+        int slot = 0;
+        while (slot < used && owners[slot] != &buffer) {
+            slot++;
+        }
+        if (slot == used) {
+            CV_Assert(used < WORKSPACE_SLOTS);
+            owners[used++] = &buffer;
+        }
+        Mat &store = stores[slot];
+        if (store.type() != CV_32F || store.cols != cols || store.rows < rows) {
+            capacity = std::max(capacity, rows);
+            store.create(capacity, cols, CV_32F);
+        }
+        buffer = store.rowRange(0, rows);
+    }
+
+    void reserveRows(Mat &m, int capacity, int cols, int type) {
+        const size_t bytes = (size_t)capacity * cols * CV_ELEM_SIZE(type);
+        if (!m.data || m.type() != type || m.cols != cols || m.isSubmatrix() ||
+            (size_t)(m.datalimit - m.datastart) < bytes) {
+            m.create(capacity, cols, type);
+        }
+        m.pop_back(m.rows);
     }
 
     /* LOGGING */
@@ -275,6 +1079,14 @@ namespace cv {
         printMat<double>(title, mag);
     }
 
+    QuietConsole::QuietConsole() {
+        console = std::cout.rdbuf(&null);
+    }
+
+    QuietConsole::~QuietConsole() {
+        std::cout.rdbuf(console);
+    }
+
     void printMatInfo(const std::string &name, InputArray _a) {
         Mat a = _a.getMat();
         std::cout << name << ": " << a.rows << "x" << a.cols
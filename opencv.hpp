@@ -12,6 +12,8 @@
 #include <stdio.h>
 
 #include <iostream>
+#include <map>
+#include <vector>
 #include <opencv2/core.hpp>
 
 namespace cv {
@@ -36,15 +38,201 @@ namespace cv {
     void denoise(cv::InputArray _a, cv::InputArray _jumps, cv::OutputArray _b);
     void detrend(cv::InputArray _a, cv::OutputArray _b, int lambda);
     void movingAverage(cv::InputArray _a, cv::OutputArray _b, int n, int s);
-    void bandpass(cv::InputArray _a, cv::OutputArray _b, double low, double high);
+    void movingAverageUpdate(cv::InputArray _a, cv::InputOutputArray _b, int n, int s, int dropped, int added);
+    void combine(cv::InputArray _a, double alpha, cv::InputArray _b, double beta, cv::OutputArray _c);
+    void bandpass(cv::InputArray _a, cv::OutputArray _b, double low, double high, bool pad = false);
     void butterworth_bandpass_filter(cv::Mat &filter, double cutin, double cutoff, int n);
+    cv::Mat butterworth_bandpass_response(int length, double cutin, double cutoff, int n);
     void butterworth_lowpass_filter(cv::Mat &filter, double cutoff, int n);
-    void frequencyToTime(cv::InputArray _a, cv::OutputArray _b);
-    void timeToFrequency(cv::InputArray _a, cv::OutputArray _b, bool magnitude);
+    void frequencyToTime(cv::InputArray _a, cv::OutputArray _b, int length = -1);
+    void timeToFrequency(cv::InputArray _a, cv::OutputArray _b, bool magnitude, bool pad = false);
+    double interpolatePeak(cv::InputArray _a, int peak);
+    double spectralSnr(cv::InputArray _a, int peak, int low, int high);
     void pcaComponent(cv::InputArray _a, cv::OutputArray _b, cv::OutputArray _pc, int low, int high);
 
+    /* STREAMING PCA */
+
+    // Mean and covariance of 3-channel samples, accumulated one sample at a time
+    class RunningCovariance {
+
+    public:
+
+        RunningCovariance() { reset(); }
+
+        void reset();
+        void add(const float *x);
+        int count() const { return n; }
+        cv::Matx33d covariance() const;
+
+    private:
+
+        int n;
+        double origin[3];
+        double sum[3];
+        double sumSq[3][3];
+    };
+
+    void eigenSymmetric3(const cv::Matx33d &a, cv::Vec3d &values, cv::Matx33d &vectors);
+
+    // Component selection across consecutive windows. The eigenvectors come from
+    // the covariance of the window passed in, as in pcaComponent, so a rescored
+    // selection is the batch one. Components are only rescored when the selected
+    // eigenvector rotates by more than maxAngle; until then the eigenvector
+    // closest to the last selection is kept, with its sign.
+    class StreamingPCA {
+
+    public:
+
+        StreamingPCA() { reset(); }
+
+        void reset();
+        void component(cv::InputArray _a, cv::OutputArray _b, cv::OutputArray _pc,
+                       int low, int high, double maxAngle);
+        bool wasRescored() const { return rescored; }
+
+    private:
+
+        RunningCovariance covariance;
+        cv::Vec3d selected;
+        bool valid;
+        bool rescored;
+    };
+
+    /* PULSE PROJECTIONS */
+
+    // Pulse of a short window of BGR means for overlap-add, zero mean.
+    // POS: plane orthogonal to skin (Wang et al. 2017).
+    // CHROM: chrominance X - alpha Y, Hann weighted (de Haan & Jeanne 2013).
+    void posProjection(cv::InputArray _c, cv::OutputArray _h);
+    void chromProjection(cv::InputArray _c, cv::OutputArray _h);
+
+    /* STREAMING FILTERS */
+
+    // Butterworth bandpass as a cascade of biquads, filtering one sample at a time
+    class IIRBandpass {
+
+    public:
+
+        IIRBandpass() : rate(0) {;}
+
+        // Design for cutoffs in Hz at sampling rate fs; order applies to each edge
+        void design(double low, double high, double fs, int order);
+        bool designed() const { return rate > 0; }
+        double fs() const { return rate; }
+
+        void reset();
+        float filter(float x);
+
+    private:
+
+        struct Biquad {
+            double b0, b1, b2, a1, a2;
+            double z1, z2;
+        };
+
+        void addSection(double f0, double q, double fs, bool highpass);
+
+        std::vector<Biquad> sections;
+        double rate;
+    };
+
+    /* STREAMING SPECTRA */
+
+    // Welch power spectrum of a weighted sum of channels, averaged over Hann
+    // windowed segments of a given length and hop. Per segment the auto and
+    // cross spectra of the channels are kept, so the weights can change freely.
+    // Segments are aligned to absolute sample indices and cached, so while the
+    // samples are final only newly completed segments are transformed.
+    class WelchSpectrum {
+
+    public:
+
+        WelchSpectrum() : length(0), hop(0), channels(0) {;}
+
+        void configure(int length, int hop, int channels);
+        bool configured() const { return length > 0; }
+        int segmentLength() const { return length; }
+        int segments() const { return (int)cache.size(); }
+
+        void reset();
+
+        // a holds one column per channel and starts at absolute sample index start.
+        // Cached segments are only reused if reuse is set.
+        void update(cv::InputArray _a, int64_t start, bool reuse);
+
+        // Magnitude spectrum (square root of the mean power) of the weighted sum,
+        // mirrored to segmentLength() rows like timeToFrequency
+        void spectrum(const double *weights, cv::OutputArray _b) const;
+
+    private:
+
+        struct Segment {
+            int64_t start;
+            cv::Mat power;
+        };
+
+        void transform(const cv::Mat &a, int offset, cv::Mat &power);
+
+        std::vector<Segment> cache;
+        std::vector<cv::Mat> spares;
+        cv::Mat sum;
+        cv::Mat window;
+        cv::Mat buffer;
+        cv::Mat ccs;
+        int length;
+        int hop;
+        int channels;
+    };
+
+    /* WORKSPACE */
+
+    #define WORKSPACE_SLOTS 32
+
+    // Backing stores for float buffers whose length follows the signal window.
+    // A buffer is bound as a view of its store at the current size, so resizing
+    // within the capacity reuses the storage; a store that is too small grows once.
+    // A buffer claims a fixed slot on its first bind.
+    class Workspace {
+
+    public:
+
+        Workspace() : used(0), capacity(0) {;}
+
+        void reserve(int rows) { capacity = std::max(capacity, rows); }
+        void bind(cv::Mat &buffer, int rows, int cols);
+
+    private:
+
+        const cv::Mat *owners[WORKSPACE_SLOTS];
+        cv::Mat stores[WORKSPACE_SLOTS];
+        int used;
+        int capacity;
+    };
+
+    // Make room for capacity rows of a cols x type buffer and empty it, keeping
+    // its storage, so appending rows up to the capacity does not allocate
+    void reserveRows(cv::Mat &m, int capacity, int cols, int type);
+
+    // Size the transform scratch of this thread for windows up to n samples
+    void reserveTransforms(int n);
+
     /* LOGGING */
 
+    // Silences std::cout while in scope, e.g. the per-frame output of
+    // pipelines run in bulk
+    class QuietConsole {
+    public:
+        QuietConsole();
+        ~QuietConsole();
+    private:
+        class NullBuffer : public std::streambuf {
+        protected:
+            int overflow(int c) { return c; }
+        };
+        NullBuffer null;
+        std::streambuf *console;
+    };
+
     void printMatInfo(const std::string &name, InputArray _a);
 
     template<typename T>